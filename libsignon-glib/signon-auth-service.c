@@ -40,9 +40,15 @@
 
 G_DEFINE_TYPE (SignonAuthService, signon_auth_service, G_TYPE_OBJECT);
 
+enum
+{
+    PROP_0,
+    PROP_CONTEXT
+};
+
 struct _SignonAuthServicePrivate
 {
-    SsoAuthService *proxy;
+    SignonContext *context;
     GCancellable *cancellable;
 };
 
@@ -63,6 +69,44 @@ typedef struct _MechanismCbData
 
 #define SIGNON_AUTH_SERVICE_PRIV(obj) (SIGNON_AUTH_SERVICE(obj)->priv)
 
+static void
+signon_auth_service_set_property (GObject *object,
+                                  guint property_id,
+                                  const GValue *value,
+                                  GParamSpec *pspec)
+{
+    SignonAuthService *self = SIGNON_AUTH_SERVICE (object);
+
+    switch (property_id)
+    {
+    case PROP_CONTEXT:
+        self->priv->context = g_value_dup_object (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+        break;
+    }
+}
+
+static void
+signon_auth_service_get_property (GObject *object,
+                                  guint property_id,
+                                  GValue *value,
+                                  GParamSpec *pspec)
+{
+    SignonAuthService *self = SIGNON_AUTH_SERVICE (object);
+
+    switch (property_id)
+    {
+    case PROP_CONTEXT:
+        g_value_set_object (value, self->priv->context);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+        break;
+    }
+}
+
 static void
 signon_auth_service_init (SignonAuthService *auth_service)
 {
@@ -72,9 +116,18 @@ signon_auth_service_init (SignonAuthService *auth_service)
                                         SignonAuthServicePrivate);
     auth_service->priv = priv;
 
-    /* Create the proxy */
     priv->cancellable = g_cancellable_new ();
-    priv->proxy = sso_auth_service_get_instance ();
+}
+
+static void
+signon_auth_service_constructed (GObject *object)
+{
+    SignonAuthServicePrivate *priv = SIGNON_AUTH_SERVICE_PRIV (object);
+
+    G_OBJECT_CLASS (signon_auth_service_parent_class)->constructed (object);
+
+    if (priv->context == NULL)
+        priv->context = g_object_ref (signon_context_get_default ());
 }
 
 static void
@@ -90,11 +143,7 @@ signon_auth_service_dispose (GObject *object)
         priv->cancellable = NULL;
     }
 
-    if (priv->proxy)
-    {
-        g_object_unref (priv->proxy);
-        priv->proxy = NULL;
-    }
+    g_clear_object (&priv->context);
 
     G_OBJECT_CLASS (signon_auth_service_parent_class)->dispose (object);
 }
@@ -112,8 +161,27 @@ signon_auth_service_class_init (SignonAuthServiceClass *klass)
 
     g_type_class_add_private (object_class, sizeof (SignonAuthServicePrivate));
 
+    object_class->constructed = signon_auth_service_constructed;
+    object_class->set_property = signon_auth_service_set_property;
+    object_class->get_property = signon_auth_service_get_property;
     object_class->dispose = signon_auth_service_dispose;
     object_class->finalize = signon_auth_service_finalize;
+
+    /**
+     * SignonAuthService:context:
+     *
+     * The #SignonContext used by the service. If not set, the default
+     * context is used.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_CONTEXT,
+        g_param_spec_object ("context",
+                             "Context",
+                             "The signon context",
+                             SIGNON_TYPE_CONTEXT,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+                             G_PARAM_STATIC_STRINGS));
 }
 
 /**
@@ -129,21 +197,43 @@ signon_auth_service_new ()
     return g_object_new (SIGNON_TYPE_AUTH_SERVICE, NULL);
 }
 
+/**
+ * signon_auth_service_new_with_context:
+ * @context: the #SignonContext to be used.
+ *
+ * Create a new #SignonAuthService, using @context to communicate with the
+ * signon daemon.
+ *
+ * Returns: an instance of an #SignonAuthService.
+ *
+ * Since: 1.15
+ */
+SignonAuthService *
+signon_auth_service_new_with_context (SignonContext *context)
+{
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (context), NULL);
+
+    return g_object_new (SIGNON_TYPE_AUTH_SERVICE,
+                         "context", context,
+                         NULL);
+}
+
 static void
 auth_query_methods_cb (GObject *object, GAsyncResult *res,
                        gpointer user_data)
 {
-    SsoAuthService *proxy = SSO_AUTH_SERVICE (object);
     MethodCbData *data = (MethodCbData*)user_data;
     gchar **value = NULL;
     GError *error = NULL;
 
     g_return_if_fail (data != NULL);
 
-    sso_auth_service_call_query_methods_finish (proxy, &value,
-                                                res, &error);
-    (data->cb)
-        (data->service, value, error, data->userdata);
+    value = signon_context_query_methods_finish (SIGNON_CONTEXT (object),
+                                                 res, &error);
+    /* Do not invoke the callback if the service was destroyed */
+    if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        (data->cb)
+            (data->service, value, error, data->userdata);
 
     g_strfreev (value);
     if (error)
@@ -155,17 +245,18 @@ static void
 auth_query_mechanisms_cb (GObject *object, GAsyncResult *res,
                           gpointer user_data)
 {
-    SsoAuthService *proxy = SSO_AUTH_SERVICE (object);
     MechanismCbData *data = (MechanismCbData*) user_data;
     gchar **value = NULL;
     GError *error = NULL;
 
     g_return_if_fail (data != NULL);
 
-    sso_auth_service_call_query_mechanisms_finish (proxy, &value,
-                                                   res, &error);
-    (data->cb)
-        (data->service, data->method, value, error, data->userdata);
+    value = signon_context_query_mechanisms_finish (SIGNON_CONTEXT (object),
+                                                    res, &error);
+    /* Do not invoke the callback if the service was destroyed */
+    if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        (data->cb)
+            (data->service, data->method, value, error, data->userdata);
 
     g_strfreev (value);
     if (error)
@@ -190,7 +281,8 @@ auth_query_mechanisms_cb (GObject *object, GAsyncResult *res,
  * @cb: (scope async): callback to be invoked.
  * @user_data: user data.
  *
- * Lists all the available methods.
+ * Lists all the available methods. The result is cached by the
+ * #SignonContext of @auth_service; see #SignonContext:query-cache-ttl.
  */
 void
 signon_auth_service_query_methods (SignonAuthService *auth_service,
@@ -209,10 +301,10 @@ signon_auth_service_query_methods (SignonAuthService *auth_service,
     cb_data->cb = cb;
     cb_data->userdata = user_data;
 
-    sso_auth_service_call_query_methods (priv->proxy,
-                                         priv->cancellable,
-                                         auth_query_methods_cb,
-                                         cb_data);
+    signon_context_query_methods_async (priv->context,
+                                        priv->cancellable,
+                                        auth_query_methods_cb,
+                                        cb_data);
 }
 
 /**
@@ -234,7 +326,8 @@ signon_auth_service_query_methods (SignonAuthService *auth_service,
  * @cb: (scope async): callback to be invoked.
  * @user_data: user data.
  *
- * Lists all the available mechanisms.
+ * Lists all the available mechanisms. The result is cached by the
+ * #SignonContext of @auth_service; see #SignonContext:query-cache-ttl.
  */
 void
 signon_auth_service_query_mechanisms (SignonAuthService *auth_service,
@@ -245,6 +338,7 @@ signon_auth_service_query_mechanisms (SignonAuthService *auth_service,
     SignonAuthServicePrivate *priv;
 
     g_return_if_fail (SIGNON_IS_AUTH_SERVICE (auth_service));
+    g_return_if_fail (method != NULL);
     g_return_if_fail (cb != NULL);
     priv = SIGNON_AUTH_SERVICE_PRIV (auth_service);
 
@@ -255,9 +349,137 @@ signon_auth_service_query_mechanisms (SignonAuthService *auth_service,
     cb_data->userdata = user_data;
     cb_data->method = g_strdup (method);
 
-    sso_auth_service_call_query_mechanisms (priv->proxy,
-                                            method,
-                                            priv->cancellable,
-                                            auth_query_mechanisms_cb,
-                                            cb_data);
+    signon_context_query_mechanisms_async (priv->context,
+                                           method,
+                                           priv->cancellable,
+                                           auth_query_mechanisms_cb,
+                                           cb_data);
+}
+
+static void
+auth_query_identities_reply (GObject *object, GAsyncResult *res,
+                             gpointer user_data)
+{
+    GTask *task = user_data;
+    GVariant *reply, *list;
+    GError *error = NULL;
+
+    reply = g_dbus_proxy_call_finish (G_DBUS_PROXY (object), res, &error);
+    if (G_UNLIKELY (error != NULL))
+    {
+        g_task_return_error (task, error);
+    }
+    else if (!g_variant_is_of_type (reply, G_VARIANT_TYPE ("(aa{sv})")))
+    {
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                 "Unexpected reply type %s",
+                                 g_variant_get_type_string (reply));
+        g_variant_unref (reply);
+    }
+    else
+    {
+        /* The identities are decoded only when the iterator is consumed */
+        list = g_variant_get_child_value (reply, 0);
+        g_task_return_pointer (task, signon_identity_info_iter_new (list),
+                               (GDestroyNotify)signon_identity_info_iter_unref);
+        g_variant_unref (list);
+        g_variant_unref (reply);
+    }
+    g_object_unref (task);
+}
+
+static void
+auth_query_identities_proxy_cb (GObject *object, GAsyncResult *res,
+                                gpointer user_data)
+{
+    GTask *task = user_data;
+    SsoAuthService *proxy;
+    GError *error = NULL;
+
+    proxy = sso_auth_service_get_instance_finish (res, &error);
+    if (G_UNLIKELY (error != NULL))
+    {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    g_dbus_proxy_call (G_DBUS_PROXY (proxy),
+                       "queryIdentities",
+                       g_variant_new ("(@a{sv})", g_task_get_task_data (task)),
+                       G_DBUS_CALL_FLAGS_NONE,
+                       -1,
+                       g_task_get_cancellable (task),
+                       auth_query_identities_reply,
+                       task);
+    g_object_unref (proxy);
+}
+
+/**
+ * signon_auth_service_query_identities_async:
+ * @auth_service: the #SignonAuthService.
+ * @filter: (transfer floating) (allow-none): a dictionary of filter
+ * criteria, or %NULL to list all the identities.
+ * @cancellable: (allow-none): optional #GCancellable object, %NULL to ignore.
+ * @callback: (scope async): a callback which will be called when the list of
+ * identities is available.
+ * @user_data: user data to be passed to the callback.
+ *
+ * Lists the identities stored by the signon daemon. The filter criteria
+ * supported by @filter depend on the signon daemon; note that the daemon
+ * might also refuse to list the identities to non privileged clients.
+ *
+ * Since: 1.15
+ */
+void
+signon_auth_service_query_identities_async (SignonAuthService *auth_service,
+                                            GVariant *filter,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback,
+                                            gpointer user_data)
+{
+    SignonAuthServicePrivate *priv;
+    GTask *task;
+
+    g_return_if_fail (SIGNON_IS_AUTH_SERVICE (auth_service));
+    g_return_if_fail (filter == NULL ||
+                      g_variant_is_of_type (filter, G_VARIANT_TYPE_VARDICT));
+    priv = SIGNON_AUTH_SERVICE_PRIV (auth_service);
+
+    if (filter == NULL)
+        filter = g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0);
+
+    task = g_task_new (auth_service, cancellable, callback, user_data);
+    g_task_set_task_data (task, g_variant_ref_sink (filter),
+                          (GDestroyNotify)g_variant_unref);
+
+    sso_auth_service_get_instance_async (priv->context,
+                                         cancellable,
+                                         auth_query_identities_proxy_cb,
+                                         task);
+}
+
+/**
+ * signon_auth_service_query_identities_finish:
+ * @auth_service: the #SignonAuthService.
+ * @res: A #GAsyncResult obtained from the #GAsyncReadyCallback passed to
+ * signon_auth_service_query_identities_async().
+ * @error: return location for error, or %NULL.
+ *
+ * Collect the result of the signon_auth_service_query_identities_async()
+ * operation.
+ *
+ * Returns: (transfer full): a #SignonIdentityInfoIter over the identities,
+ * or %NULL if an error occurred.
+ *
+ * Since: 1.15
+ */
+SignonIdentityInfoIter *
+signon_auth_service_query_identities_finish (SignonAuthService *auth_service,
+                                             GAsyncResult *res,
+                                             GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (res, auth_service), NULL);
+
+    return g_task_propagate_pointer (G_TASK (res), error);
 }
@@ -27,6 +27,8 @@
 #define _SIGNON_AUTH_SERVICE_H_
 
 #include <glib-object.h>
+#include <libsignon-glib/signon-context.h>
+#include <libsignon-glib/signon-identity-info.h>
 
 G_BEGIN_DECLS
 
@@ -76,6 +78,7 @@ typedef void (*SignonQueryMechanismCb) (SignonAuthService *auth_service,
                                         gpointer user_data);
 
 SignonAuthService *signon_auth_service_new ();
+SignonAuthService *signon_auth_service_new_with_context (SignonContext *context);
 
 void signon_auth_service_query_methods (SignonAuthService *auth_service,
                                         SignonQueryMethodsCb cb,
@@ -84,6 +87,17 @@ void signon_auth_service_query_mechanisms (SignonAuthService *auth_service,
                                            const gchar *method,
                                            SignonQueryMechanismCb cb,
                                            gpointer user_data);
+
+void signon_auth_service_query_identities_async (SignonAuthService *auth_service,
+                                                 GVariant *filter,
+                                                 GCancellable *cancellable,
+                                                 GAsyncReadyCallback callback,
+                                                 gpointer user_data);
+SignonIdentityInfoIter *
+signon_auth_service_query_identities_finish (SignonAuthService *auth_service,
+                                             GAsyncResult *res,
+                                             GError **error);
+
 G_END_DECLS
 
 #endif /* _SIGNON_AUTH_SERVICE_H_ */
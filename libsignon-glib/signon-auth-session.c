@@ -40,6 +40,7 @@
 
 #include "signon-internals.h"
 #include "signon-auth-session.h"
+#include "signon-enum-types.h"
 #include "signon-errors.h"
 #include "signon-marshal.h"
 #include "signon-proxy.h"
@@ -49,6 +50,7 @@
 
 /* SignonAuthSessionState is defined in signoncommon.h */
 #include <signoncommon.h>
+#include <string.h>
 
 static void signon_auth_session_proxy_if_init (SignonProxyInterface *iface);
 
@@ -56,6 +58,14 @@ G_DEFINE_TYPE_WITH_CODE (SignonAuthSession, signon_auth_session, G_TYPE_OBJECT,
                          G_IMPLEMENT_INTERFACE (SIGNON_TYPE_PROXY,
                                                 signon_auth_session_proxy_if_init))
 
+enum
+{
+    PROP_0,
+    PROP_CONTEXT,
+    PROP_PRIORITY,
+    PROP_TIMEOUT
+};
+
 /* Signals */
 enum
 {
@@ -71,12 +81,17 @@ static const gchar data_key_process[] = "signon-process";
 
 struct _SignonAuthSessionPrivate
 {
+    SignonContext *context;
     SsoAuthSession *proxy;
     SsoAuthService *auth_service_proxy;
     GCancellable *cancellable;
 
     gint id;
     gchar *method_name;
+    SignonAuthSessionFlags flags;
+    SignonPriority priority;
+    /* Milliseconds, or 0 */
+    guint timeout;
 
     gboolean registering;
     gboolean busy;
@@ -85,6 +100,12 @@ struct _SignonAuthSessionPrivate
 
     guint signal_state_changed;
     guint signal_unregistered;
+
+    /* Process requests waiting to be sent, in order */
+    GQueue pending;
+    /* The process request being handled, or NULL */
+    GTask *running;
+    SignonPriority running_priority;
 };
 
 typedef struct _AuthSessionQueryAvailableMechanismsData
@@ -97,6 +118,20 @@ typedef struct _AuthSessionProcessData
 {
     GVariant *session_data;
     gchar *mechanism;
+    /* Where to cache the reply, or NULL */
+    gchar *token_cache_key;
+    /* Key of the D-Bus call shared with identical requests, or NULL */
+    gchar *shared_key;
+    SignonPriority priority;
+    /* Monotonic time, or 0 */
+    gint64 deadline;
+    /* Expires the request while it is queued or waiting for a shared call */
+    GSource *deadline_source;
+    /* Watched while the request is waiting, to fail it when cancelled */
+    GCancellable *cancellable;
+    gulong cancelled_id;
+    /* Whether the request is in the session queue */
+    gboolean queued;
 } AuthSessionProcessData;
 
 typedef struct _AuthSessionQueryAvailableMechanismsCbData
@@ -126,42 +161,182 @@ static void auth_session_query_available_mechanisms_ready_cb (gpointer object, c
 static void auth_session_cancel_ready_cb (gpointer object, const GError *error, gpointer user_data);
 
 static void auth_session_check_remote_object(SignonAuthSession *self);
+static void auth_session_process_dispatch (GTask *res);
+static void auth_session_process_watch (GTask *res);
+
+/* Stops watching the request, which is not waiting anymore */
+static void
+auth_session_process_unwatch (AuthSessionProcessData *process_data)
+{
+    if (process_data->deadline_source != NULL)
+    {
+        g_source_destroy (process_data->deadline_source);
+        g_source_unref (process_data->deadline_source);
+        process_data->deadline_source = NULL;
+    }
+    if (process_data->cancellable != NULL)
+    {
+        if (process_data->cancelled_id != 0)
+            g_cancellable_disconnect (process_data->cancellable,
+                                      process_data->cancelled_id);
+        process_data->cancelled_id = 0;
+        g_clear_object (&process_data->cancellable);
+    }
+}
 
 static void
 auth_session_process_data_free (AuthSessionProcessData *process_data)
 {
     g_free (process_data->mechanism);
+    g_free (process_data->token_cache_key);
+    g_free (process_data->shared_key);
+    auth_session_process_unwatch (process_data);
     g_variant_unref (process_data->session_data);
     g_slice_free (AuthSessionProcessData, process_data);
 }
 
+static gboolean
+error_is_cancellation (const GError *error)
+{
+    return g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+        g_error_matches (error, signon_error_quark (),
+                         SIGNON_ERROR_SESSION_CANCELED);
+}
+
+/* Completes @res with either @reply or @error (both owned), and the
+ * requests which were sharing its D-Bus call */
+static void
+auth_session_process_return (GTask *res, GVariant *reply, GError *error)
+{
+    SignonAuthSession *self;
+    AuthSessionProcessData *process_data;
+    GQueue *waiters = NULL;
+    GTask *task;
+
+    self = SIGNON_AUTH_SESSION (g_task_get_source_object (res));
+    process_data = g_object_get_data ((GObject *)res, data_key_process);
+
+    if (reply != NULL && process_data->token_cache_key != NULL)
+        signon_context_store_token (self->priv->context,
+                                    process_data->token_cache_key,
+                                    self->priv->id, reply);
+
+    if (process_data->shared_key != NULL)
+        waiters = signon_context_complete_process (self->priv->context,
+                                                   process_data->shared_key);
+
+    if (waiters != NULL && !g_queue_is_empty (waiters) &&
+        error_is_cancellation (error))
+    {
+        /* Only this request was cancelled: the next one takes over the
+         * call, and the others keep waiting for it */
+        task = g_queue_pop_head (waiters);
+        auth_session_process_unwatch (g_object_get_data ((GObject *)task,
+                                                         data_key_process));
+        signon_context_join_process (self->priv->context,
+                                     process_data->shared_key, task);
+        while (!g_queue_is_empty (waiters))
+        {
+            GTask *waiter = g_queue_pop_head (waiters);
+            signon_context_join_process (self->priv->context,
+                                         process_data->shared_key, waiter);
+            g_object_unref (waiter);
+        }
+        auth_session_process_dispatch (task);
+    }
+
+    while (waiters != NULL && (task = g_queue_pop_head (waiters)) != NULL)
+    {
+        auth_session_process_unwatch (g_object_get_data ((GObject *)task,
+                                                         data_key_process));
+        if (reply != NULL)
+            g_task_return_pointer (task, g_variant_ref (reply),
+                                   (GDestroyNotify) g_variant_unref);
+        else
+            g_task_return_error (task, g_error_copy (error));
+        g_object_unref (task);
+    }
+    if (waiters != NULL)
+        g_queue_free (waiters);
+
+    if (reply != NULL)
+        g_task_return_pointer (res, reply, (GDestroyNotify) g_variant_unref);
+    else
+        g_task_return_error (res, error);
+}
+
+/* Called when the running request has completed */
+static void
+auth_session_process_done (SignonAuthSession *self)
+{
+    SignonAuthSessionPrivate *priv = self->priv;
+
+    priv->busy = FALSE;
+    priv->running = NULL;
+    signon_context_release_process_slot (priv->context,
+                                         priv->running_priority);
+    signon_auth_session_process_next (self);
+}
+
+/* A request which missed its deadline fails with its own error, so that
+ * callers can tell it apart from the timeout of a D-Bus call */
+static GError *
+auth_session_deadline_error (void)
+{
+    return g_error_new_literal (signon_error_quark (),
+                                SIGNON_ERROR_TIMED_OUT,
+                                "The request missed its deadline");
+}
+
+/* The D-Bus calls made on behalf of @res are given the time left before its
+ * deadline: their timeout is the deadline. Takes ownership of @error. */
+static GError *
+auth_session_process_map_timeout (GTask *res, GError *error)
+{
+    AuthSessionProcessData *process_data =
+        g_object_get_data ((GObject *)res, data_key_process);
+
+    if (process_data->deadline != 0 &&
+        g_error_matches (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT) &&
+        g_get_monotonic_time () >= process_data->deadline)
+    {
+        g_error_free (error);
+        error = auth_session_deadline_error ();
+    }
+    return error;
+}
+
 static void
 auth_session_process_reply (GObject *object, GAsyncResult *res,
                             gpointer userdata)
 {
     SignonAuthSession *self;
-    SsoAuthSession *proxy = SSO_AUTH_SESSION (object);
     GTask *res_process = userdata;
-    GVariant *reply;
+    GVariant *result;
+    GVariant *reply = NULL;
     GError *error = NULL;
 
     g_return_if_fail (res_process != NULL);
 
-    sso_auth_session_call_process_finish (proxy, &reply, res, &error);
+    result = g_dbus_proxy_call_finish (G_DBUS_PROXY (object), res, &error);
+    if (G_LIKELY (result != NULL))
+    {
+        g_variant_get (result, "(@a{sv})", &reply);
+        g_variant_unref (result);
+    }
 
     self = SIGNON_AUTH_SESSION (g_task_get_source_object (res_process));
-    self->priv->busy = FALSE;
 
-    if (G_LIKELY (error == NULL))
-    {
-        g_task_return_pointer (res_process, reply,
-                               (GDestroyNotify) g_variant_unref);
-    }
-    else
+    /* Don't leave the plugin running for nobody */
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT))
     {
-        g_task_return_error (res_process, error);
+        sso_auth_session_call_cancel (SSO_AUTH_SESSION (object),
+                                      NULL, NULL, NULL);
+        error = auth_session_process_map_timeout (res_process, error);
     }
 
+    auth_session_process_return (res_process, reply, error);
+    auth_session_process_done (self);
     g_object_unref (res_process);
 }
 
@@ -172,6 +347,7 @@ auth_session_process_ready_cb (gpointer object, const GError *error, gpointer us
     SignonAuthSessionPrivate *priv;
     GTask *res = G_TASK (user_data);
     AuthSessionProcessData *process_data;
+    gint timeout_msec = -1;
 
     g_return_if_fail (self != NULL);
     priv = self->priv;
@@ -179,19 +355,22 @@ auth_session_process_ready_cb (gpointer object, const GError *error, gpointer us
     if (error != NULL)
     {
         DEBUG ("AuthSessionError: %s", error->message);
-        g_task_return_error (res, g_error_copy (error));
+        auth_session_process_return (res, NULL,
+                                     auth_session_process_map_timeout (res,
+                                         g_error_copy (error)));
+        auth_session_process_done (self);
         g_object_unref (res);
         return;
     }
 
     if (priv->canceled)
     {
-        priv->busy = FALSE;
         priv->canceled = FALSE;
-        g_task_return_new_error (res,
-                                 signon_error_quark (),
-                                 SIGNON_ERROR_SESSION_CANCELED,
-                                 "Authentication session was canceled");
+        auth_session_process_return (res, NULL,
+                                     g_error_new (signon_error_quark (),
+                                                  SIGNON_ERROR_SESSION_CANCELED,
+                                                  "Authentication session was canceled"));
+        auth_session_process_done (self);
         g_object_unref (res);
         return;
     }
@@ -199,12 +378,23 @@ auth_session_process_ready_cb (gpointer object, const GError *error, gpointer us
     process_data = g_object_get_data ((GObject *)res, data_key_process);
     g_return_if_fail (process_data != NULL);
 
-    sso_auth_session_call_process (priv->proxy,
-                                   process_data->session_data,
-                                   process_data->mechanism,
-                                   g_task_get_cancellable (res),
-                                   auth_session_process_reply,
-                                   res);
+    /* The D-Bus call gets whatever is left of the deadline */
+    if (process_data->deadline != 0)
+    {
+        gint64 remaining = process_data->deadline - g_get_monotonic_time ();
+        timeout_msec = (gint) CLAMP ((remaining + 999) / 1000, 1, G_MAXINT);
+    }
+
+    g_dbus_proxy_call ((GDBusProxy *)priv->proxy,
+                       "process",
+                       g_variant_new ("(@a{sv}s)",
+                                      process_data->session_data,
+                                      process_data->mechanism),
+                       G_DBUS_CALL_FLAGS_NONE,
+                       timeout_msec,
+                       g_task_get_cancellable (res),
+                       auth_session_process_reply,
+                       res);
 
     g_signal_emit (self,
                    auth_session_signals[STATE_CHANGED],
@@ -281,12 +471,73 @@ signon_auth_session_proxy_if_init (SignonProxyInterface *iface)
     iface->setup = signon_auth_session_proxy_setup;
 }
 
+static void
+signon_auth_session_set_property (GObject *object,
+                                  guint property_id,
+                                  const GValue *value,
+                                  GParamSpec *pspec)
+{
+    SignonAuthSession *self = SIGNON_AUTH_SESSION (object);
+
+    switch (property_id)
+    {
+    case PROP_CONTEXT:
+        self->priv->context = g_value_dup_object (value);
+        break;
+    case PROP_PRIORITY:
+        self->priv->priority = g_value_get_enum (value);
+        break;
+    case PROP_TIMEOUT:
+        self->priv->timeout = g_value_get_uint (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+        break;
+    }
+}
+
+static void
+signon_auth_session_get_property (GObject *object,
+                                  guint property_id,
+                                  GValue *value,
+                                  GParamSpec *pspec)
+{
+    SignonAuthSession *self = SIGNON_AUTH_SESSION (object);
+
+    switch (property_id)
+    {
+    case PROP_CONTEXT:
+        g_value_set_object (value, self->priv->context);
+        break;
+    case PROP_PRIORITY:
+        g_value_set_enum (value, self->priv->priority);
+        break;
+    case PROP_TIMEOUT:
+        g_value_set_uint (value, self->priv->timeout);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+        break;
+    }
+}
+
 static void
 signon_auth_session_init (SignonAuthSession *self)
 {
     self->priv = SIGNON_AUTH_SESSION_GET_PRIV (self);
-    self->priv->auth_service_proxy = sso_auth_service_get_instance ();
     self->priv->cancellable = g_cancellable_new ();
+    g_queue_init (&self->priv->pending);
+}
+
+static void
+signon_auth_session_constructed (GObject *object)
+{
+    SignonAuthSessionPrivate *priv = SIGNON_AUTH_SESSION_PRIV (object);
+
+    G_OBJECT_CLASS (signon_auth_session_parent_class)->constructed (object);
+
+    if (priv->context == NULL)
+        priv->context = g_object_ref (signon_context_get_default ());
 }
 
 static void
@@ -308,7 +559,24 @@ signon_auth_session_dispose (GObject *object)
     }
 
     if (priv->proxy)
-        destroy_proxy (priv);
+    {
+        /* An idle remote session can serve another SignonAuthSession;
+         * without an identity, it might hold the data of the previous
+         * user, so it's never shared */
+        if (!priv->busy && priv->id != 0 && priv->context != NULL)
+        {
+            g_signal_handler_disconnect (priv->proxy,
+                                         priv->signal_state_changed);
+            g_signal_handler_disconnect (priv->proxy,
+                                         priv->signal_unregistered);
+            signon_context_pool_auth_session (priv->context, priv->id,
+                                              priv->method_name,
+                                              (GDBusProxy *)priv->proxy);
+            priv->proxy = NULL;
+        }
+        else
+            destroy_proxy (priv);
+    }
 
     if (priv->auth_service_proxy)
     {
@@ -316,6 +584,8 @@ signon_auth_session_dispose (GObject *object)
         priv->auth_service_proxy = NULL;
     }
 
+    g_clear_object (&priv->context);
+
     G_OBJECT_CLASS (signon_auth_session_parent_class)->dispose (object);
 
     priv->dispose_has_run = TRUE;
@@ -342,6 +612,65 @@ signon_auth_session_class_init (SignonAuthSessionClass *klass)
 
     g_type_class_add_private (object_class, sizeof (SignonAuthSessionPrivate));
 
+    object_class->constructed = signon_auth_session_constructed;
+    object_class->set_property = signon_auth_session_set_property;
+    object_class->get_property = signon_auth_session_get_property;
+
+    /**
+     * SignonAuthSession:context:
+     *
+     * The #SignonContext used by the session. If not set, the default
+     * context is used.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_CONTEXT,
+        g_param_spec_object ("context",
+                             "Context",
+                             "The signon context",
+                             SIGNON_TYPE_CONTEXT,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+                             G_PARAM_STATIC_STRINGS));
+
+    /**
+     * SignonAuthSession:priority:
+     *
+     * The #SignonPriority of the requests made with
+     * signon_auth_session_process_async(). Changes only affect the requests
+     * made afterwards.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_PRIORITY,
+        g_param_spec_enum ("priority",
+                           "Priority",
+                           "Priority of the authentication requests",
+                           SIGNON_TYPE_PRIORITY,
+                           SIGNON_PRIORITY_DEFAULT,
+                           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * SignonAuthSession:timeout:
+     *
+     * The time (in milliseconds) within which each request made with
+     * signon_auth_session_process_async() must complete, counting the time
+     * spent waiting in the queue or for the reply of an identical request
+     * (see %SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE). Requests which miss their
+     * deadline fail with %SIGNON_ERROR_TIMED_OUT, which tells them apart
+     * from the D-Bus timeouts (%G_IO_ERROR_TIMED_OUT); if the request had
+     * already reached the authentication plugin, it is cancelled. Changes
+     * only affect the requests made afterwards. The default is 0, which
+     * means no deadline.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_TIMEOUT,
+        g_param_spec_uint ("timeout",
+                           "Timeout",
+                           "Deadline of the authentication requests, in ms",
+                           0, G_MAXUINT, 0,
+                           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
     /**
      * SignonAuthSession::state-changed:
      * @auth_session: the #SignonAuthSession
@@ -367,7 +696,8 @@ signon_auth_session_class_init (SignonAuthSessionClass *klass)
 }
 
 /**
- * signon_auth_session_new:
+ * signon_auth_session_new_with_context:
+ * @context: the #SignonContext to be used.
  * @id: the id of the #SignonIdentity to be used. Can be 0, if this session is
  * not bound to any stored identity.
  * @method_name: the name of the authentication method to be used.
@@ -375,16 +705,66 @@ signon_auth_session_class_init (SignonAuthSessionClass *klass)
  * function fails.
  *
  * Creates a new #SignonAuthSession, which can be used to authenticate using
- * the specified method.
+ * the specified method. The session will use @context to communicate with the
+ * signon daemon.
  *
  * Returns: a new #SignonAuthSession.
+ *
+ * Since: 1.15
  */
 SignonAuthSession *
-signon_auth_session_new (gint id,
-                         const gchar *method_name,
-                         GError **err)
+signon_auth_session_new_with_context (SignonContext *context,
+                                      gint id,
+                                      const gchar *method_name,
+                                      GError **err)
+{
+    return signon_auth_session_new_full (context, id, method_name,
+                                         SIGNON_AUTH_SESSION_FLAG_NONE, err);
+}
+
+/**
+ * signon_auth_session_new_full:
+ * @context: (allow-none): the #SignonContext to be used, or %NULL for the
+ * default one.
+ * @id: the id of the #SignonIdentity to be used. Can be 0, if this session is
+ * not bound to any stored identity.
+ * @method_name: the name of the authentication method to be used.
+ * @flags: #SignonAuthSessionFlags.
+ * @err: a pointer to a location which will contain the error, in case this
+ * function fails.
+ *
+ * Creates a new #SignonAuthSession, like
+ * signon_auth_session_new_with_context() does.
+ *
+ * With %SIGNON_AUTH_SESSION_FLAG_PREFETCH, the remote session is set up right
+ * away, while the application prepares its first request: this takes a round
+ * trip off the time it takes to get a reply to it.
+ *
+ * With %SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE, concurrent requests with the
+ * same mechanism and session data (ignoring the keys which only affect the
+ * user interaction) are sent to signond only once, and all of them get the
+ * same reply. If the request which is being sent is cancelled, the next one
+ * takes its place.
+ *
+ * Returns: a new #SignonAuthSession.
+ *
+ * Since: 1.15
+ */
+SignonAuthSession *
+signon_auth_session_new_full (SignonContext *context,
+                              gint id,
+                              const gchar *method_name,
+                              SignonAuthSessionFlags flags,
+                              GError **err)
 {
-    SignonAuthSession *self = SIGNON_AUTH_SESSION(g_object_new (SIGNON_TYPE_AUTH_SESSION, NULL));
+    if (context == NULL)
+        context = signon_context_get_default ();
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (context), NULL);
+
+    SignonAuthSession *self =
+        SIGNON_AUTH_SESSION(g_object_new (SIGNON_TYPE_AUTH_SESSION,
+                                          "context", context,
+                                          NULL));
     g_return_val_if_fail (self != NULL, NULL);
 
     if (!auth_session_priv_init(self, id, method_name, err))
@@ -396,9 +776,35 @@ signon_auth_session_new (gint id,
         return NULL;
     }
 
+    self->priv->flags = flags;
+    if (flags & SIGNON_AUTH_SESSION_FLAG_PREFETCH)
+        auth_session_check_remote_object (self);
+
     return self;
 }
 
+/**
+ * signon_auth_session_new:
+ * @id: the id of the #SignonIdentity to be used. Can be 0, if this session is
+ * not bound to any stored identity.
+ * @method_name: the name of the authentication method to be used.
+ * @err: a pointer to a location which will contain the error, in case this
+ * function fails.
+ *
+ * Creates a new #SignonAuthSession, which can be used to authenticate using
+ * the specified method.
+ *
+ * Returns: a new #SignonAuthSession.
+ */
+SignonAuthSession *
+signon_auth_session_new (gint id,
+                         const gchar *method_name,
+                         GError **err)
+{
+    return signon_auth_session_new_with_context (signon_context_get_default (),
+                                                 id, method_name, err);
+}
+
 static void
 auth_session_set_id_ready_cb (gpointer object,
                               const GError *error,
@@ -463,6 +869,68 @@ signon_auth_session_get_method (SignonAuthSession *self)
     return priv->method_name;
 }
 
+/**
+ * signon_auth_session_get_queue_depth:
+ * @self: the #SignonAuthSession.
+ *
+ * Gets the number of signon_auth_session_process_async() requests which are
+ * waiting to be sent to signond. A #SignonAuthSession handles its requests
+ * one at a time, in the order they were made; requests can also be held back
+ * by the #SignonContext:max-in-flight limit of its context.
+ *
+ * Returns: the number of queued requests, not counting the one in progress.
+ *
+ * Since: 1.15
+ */
+guint
+signon_auth_session_get_queue_depth (SignonAuthSession *self)
+{
+    g_return_val_if_fail (SIGNON_IS_AUTH_SESSION (self), 0);
+
+    return g_queue_get_length (&self->priv->pending);
+}
+
+/**
+ * signon_auth_session_get_priority:
+ * @self: the #SignonAuthSession.
+ *
+ * Gets the priority of the requests made on @self.
+ *
+ * Returns: the #SignonPriority.
+ *
+ * Since: 1.15
+ */
+SignonPriority
+signon_auth_session_get_priority (SignonAuthSession *self)
+{
+    g_return_val_if_fail (SIGNON_IS_AUTH_SESSION (self),
+                          SIGNON_PRIORITY_DEFAULT);
+
+    return self->priv->priority;
+}
+
+/**
+ * signon_auth_session_set_priority:
+ * @self: the #SignonAuthSession.
+ * @priority: the #SignonPriority of the next requests.
+ *
+ * Sets the priority of the requests made on @self with
+ * signon_auth_session_process_async(). See #SignonAuthSession:priority.
+ *
+ * Since: 1.15
+ */
+void
+signon_auth_session_set_priority (SignonAuthSession *self,
+                                  SignonPriority priority)
+{
+    g_return_if_fail (SIGNON_IS_AUTH_SESSION (self));
+
+    if (self->priv->priority == priority) return;
+
+    self->priv->priority = priority;
+    g_object_notify ((GObject *)self, "priority");
+}
+
 /**
  * SignonAuthSessionQueryAvailableMechanismsCb:
  * @self: the #SignonAuthSession.
@@ -557,6 +1025,301 @@ signon_auth_session_process (SignonAuthSession *self,
                                        process_async_cb_wrapper, cb_data);
 }
 
+/* Session data keys which don't affect the reply of the plugin */
+static const gchar *request_ignored_keys[] = {
+    SIGNON_SESSION_DATA_UI_POLICY,
+    SIGNON_SESSION_DATA_CAPTION,
+    SIGNON_SESSION_DATA_TIMEOUT,
+    SIGNON_SESSION_DATA_WINDOW_ID,
+    SIGNON_SESSION_DATA_RENEW_TOKEN,
+    SIGNON_SESSION_DATA_PROXY,
+    NULL
+};
+
+static gboolean
+request_ignores_key (const gchar *key)
+{
+    const gchar **ignored;
+
+    for (ignored = request_ignored_keys; *ignored != NULL; ignored++)
+    {
+        if (strcmp (*ignored, key) == 0) return TRUE;
+    }
+    return FALSE;
+}
+
+static gint
+compare_keys (gconstpointer a, gconstpointer b)
+{
+    return g_strcmp0 (*(const gchar **)a, *(const gchar **)b);
+}
+
+/* Returns a digest of the identity, method, mechanism and of the session
+ * data, with its keys sorted: the session data may contain a secret, which
+ * we don't want to keep around. */
+static gchar *
+auth_session_request_key (SignonAuthSession *self,
+                          GVariant *session_data,
+                          const gchar *mechanism)
+{
+    SignonAuthSessionPrivate *priv = self->priv;
+    GPtrArray *keys;
+    GString *canonical;
+    GVariantIter iter;
+    const gchar *key;
+    GVariant *value;
+    gchar *digest;
+    guint i;
+
+    keys = g_ptr_array_new ();
+    g_variant_iter_init (&iter, session_data);
+    while (g_variant_iter_next (&iter, "{&sv}", &key, NULL))
+    {
+        if (!request_ignores_key (key))
+            g_ptr_array_add (keys, (gpointer)key);
+    }
+    g_ptr_array_sort (keys, compare_keys);
+
+    canonical = g_string_new (NULL);
+    g_string_append_printf (canonical, "%d\n%s\n%s\n", priv->id,
+                            priv->method_name ? priv->method_name : "",
+                            mechanism ? mechanism : "");
+    for (i = 0; i < keys->len; i++)
+    {
+        key = g_ptr_array_index (keys, i);
+        value = g_variant_lookup_value (session_data, key, NULL);
+        g_string_append_printf (canonical, "%s=", key);
+        g_variant_print_string (value, canonical, TRUE);
+        g_string_append_c (canonical, '\n');
+        g_variant_unref (value);
+    }
+    g_ptr_array_free (keys, TRUE);
+
+    digest = g_compute_checksum_for_string (G_CHECKSUM_SHA256,
+                                            canonical->str, canonical->len);
+    memset (canonical->str, 0, canonical->len);
+    g_string_free (canonical, TRUE);
+    return digest;
+}
+
+static SignonPriority
+auth_session_process_priority (GTask *res)
+{
+    AuthSessionProcessData *process_data =
+        g_object_get_data ((GObject *)res, data_key_process);
+    return process_data->priority;
+}
+
+static gint64
+auth_session_process_deadline (GTask *res)
+{
+    AuthSessionProcessData *process_data =
+        g_object_get_data ((GObject *)res, data_key_process);
+    return process_data->deadline;
+}
+
+/* Takes @res out of the session queue, or out of the requests waiting for
+ * a shared call, handing over the reference held there; returns FALSE if
+ * @res is not waiting anymore. */
+static gboolean
+auth_session_process_withdraw (GTask *res)
+{
+    SignonAuthSession *self;
+    AuthSessionProcessData *process_data;
+
+    self = SIGNON_AUTH_SESSION (g_task_get_source_object (res));
+    process_data = g_object_get_data ((GObject *)res, data_key_process);
+
+    if (g_queue_remove (&self->priv->pending, res))
+    {
+        process_data->queued = FALSE;
+        signon_context_adjust_queue_depth (self->priv->context,
+                                           process_data->priority, -1);
+    }
+    else if (process_data->shared_key != NULL &&
+             signon_context_leave_process (self->priv->context,
+                                           process_data->shared_key, res))
+    {
+        /* The call goes on for the others */
+        g_clear_pointer (&process_data->shared_key, g_free);
+    }
+    else
+        return FALSE;
+
+    auth_session_process_unwatch (process_data);
+    return TRUE;
+}
+
+static gboolean
+auth_session_process_expired_cb (gpointer user_data)
+{
+    GTask *res = user_data;
+    AuthSessionProcessData *process_data;
+
+    process_data = g_object_get_data ((GObject *)res, data_key_process);
+    g_source_unref (process_data->deadline_source);
+    process_data->deadline_source = NULL;
+
+    DEBUG ("Request expired while waiting");
+    if (auth_session_process_withdraw (res))
+    {
+        auth_session_process_return (res, NULL,
+                                     auth_session_deadline_error ());
+        g_object_unref (res);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+auth_session_process_cancelled_idle (gpointer user_data)
+{
+    GTask *res = user_data;
+
+    if (auth_session_process_withdraw (res))
+    {
+        DEBUG ("Waiting request cancelled");
+        auth_session_process_return (res, NULL,
+                                     g_error_new_literal (G_IO_ERROR,
+                                                          G_IO_ERROR_CANCELLED,
+                                                          "Operation was cancelled"));
+        g_object_unref (res);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+/* The cancellable can be triggered from any thread: the request is failed
+ * from the main context of the task */
+static void
+auth_session_process_cancelled_cb (GCancellable *cancellable,
+                                   gpointer user_data)
+{
+    GTask *res = user_data;
+    GSource *source;
+
+    source = g_idle_source_new ();
+    g_source_set_callback (source, auth_session_process_cancelled_idle,
+                           g_object_ref (res), g_object_unref);
+    g_source_attach (source, g_task_get_context (res));
+    g_source_unref (source);
+}
+
+/* Fails @res as soon as it expires or it's cancelled, while it's waiting to
+ * be sent or for the reply of a shared call */
+static void
+auth_session_process_watch (GTask *res)
+{
+    AuthSessionProcessData *process_data;
+    GCancellable *cancellable = g_task_get_cancellable (res);
+
+    process_data = g_object_get_data ((GObject *)res, data_key_process);
+    if (process_data->deadline != 0 && process_data->deadline_source == NULL)
+    {
+        gint64 delay = MAX (process_data->deadline - g_get_monotonic_time (),
+                            0);
+        process_data->deadline_source =
+            g_timeout_source_new ((guint) MIN ((delay + 999) / 1000,
+                                               G_MAXUINT));
+        g_source_set_callback (process_data->deadline_source,
+                               auth_session_process_expired_cb, res, NULL);
+        g_source_attach (process_data->deadline_source,
+                         g_main_context_get_thread_default ());
+    }
+
+    if (cancellable == NULL || process_data->cancellable != NULL)
+        return;
+
+    process_data->cancellable = g_object_ref (cancellable);
+    process_data->cancelled_id =
+        g_cancellable_connect (cancellable,
+                               G_CALLBACK (auth_session_process_cancelled_cb),
+                               res, NULL);
+}
+
+/* Removes the head of the queue, and returns it */
+static GTask *
+auth_session_pop_pending (SignonAuthSession *self)
+{
+    GTask *res = g_queue_pop_head (&self->priv->pending);
+    AuthSessionProcessData *process_data =
+        g_object_get_data ((GObject *)res, data_key_process);
+
+    process_data->queued = FALSE;
+    signon_context_adjust_queue_depth (self->priv->context,
+                                       process_data->priority, -1);
+    auth_session_process_unwatch (process_data);
+    return res;
+}
+
+/* Queues @res (owned) for sending to signond */
+static void
+auth_session_process_dispatch (GTask *res)
+{
+    SignonAuthSession *self;
+    AuthSessionProcessData *process_data;
+
+    self = SIGNON_AUTH_SESSION (g_task_get_source_object (res));
+    process_data = g_object_get_data ((GObject *)res, data_key_process);
+
+    g_queue_push_tail (&self->priv->pending, res);
+    process_data->queued = TRUE;
+    signon_context_adjust_queue_depth (self->priv->context,
+                                       process_data->priority, 1);
+
+    /* Most requests are sent right away: only those which have to wait in
+     * the queue are watched */
+    g_object_ref (res);
+    signon_auth_session_process_next (self);
+    if (process_data->queued)
+        auth_session_process_watch (res);
+    g_object_unref (res);
+}
+
+/* Sends the next queued request, unless one is already running or the
+ * context has no free slot */
+void
+signon_auth_session_process_next (SignonAuthSession *self)
+{
+    SignonAuthSessionPrivate *priv = self->priv;
+    SignonPriority priority;
+    gint64 deadline;
+    GTask *res;
+
+    /* Completing a request might drop the last reference on @self */
+    g_object_ref (self);
+
+    while (priv->running == NULL && !g_queue_is_empty (&priv->pending))
+    {
+        res = g_queue_peek_head (&priv->pending);
+        priority = auth_session_process_priority (res);
+        if (g_cancellable_is_cancelled (g_task_get_cancellable (res)))
+        {
+            auth_session_pop_pending (self);
+            auth_session_process_return (res, NULL,
+                                         g_error_new_literal (G_IO_ERROR,
+                                                              G_IO_ERROR_CANCELLED,
+                                                              "Operation was cancelled"));
+            g_object_unref (res);
+            continue;
+        }
+
+        if (!signon_context_acquire_process_slot (priv->context, self,
+                                                  priority))
+            break;
+
+        auth_session_pop_pending (self);
+        priv->running = res;
+        priv->running_priority = priority;
+        priv->busy = TRUE;
+        deadline = auth_session_process_deadline (res);
+        signon_proxy_call_when_ready_with_deadline (self,
+                                                    auth_session_object_quark(),
+                                                    auth_session_process_ready_cb,
+                                                    res, deadline);
+    }
+
+    g_object_unref (self);
+}
+
 /**
  * signon_auth_session_process_async:
  * @self: the #SignonAuthSession.
@@ -586,6 +1349,10 @@ signon_auth_session_process_async (SignonAuthSession *self,
 {
     SignonAuthSessionPrivate *priv;
     AuthSessionProcessData *process_data;
+    GVariant *cached_reply;
+    gboolean renew_token = FALSE;
+    gboolean use_cache;
+    gchar *key;
     GTask *res;
 
     g_return_if_fail (SIGNON_IS_AUTH_SESSION (self));
@@ -598,15 +1365,59 @@ signon_auth_session_process_async (SignonAuthSession *self,
     process_data = g_slice_new0 (AuthSessionProcessData);
     process_data->session_data = g_variant_ref_sink (session_data);
     process_data->mechanism = g_strdup (mechanism);
+    process_data->priority = priv->priority;
+    if (priv->timeout > 0)
+        process_data->deadline =
+            g_get_monotonic_time () + (gint64) priv->timeout * 1000;
     g_object_set_data_full ((GObject *)res, data_key_process, process_data,
                             (GDestroyNotify)auth_session_process_data_free);
 
-    priv->busy = TRUE;
+    use_cache = signon_context_get_token_cache_ttl (priv->context) > 0;
+    if (!use_cache && !(priv->flags & SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE))
+    {
+        auth_session_process_dispatch (res);
+        return;
+    }
 
-    signon_proxy_call_when_ready (self,
-                                  auth_session_object_quark(),
-                                  auth_session_process_ready_cb,
-                                  res);
+    key = auth_session_request_key (self, session_data, mechanism);
+    g_variant_lookup (session_data, SIGNON_SESSION_DATA_RENEW_TOKEN,
+                      "b", &renew_token);
+
+    if (use_cache)
+    {
+        process_data->token_cache_key = g_strdup (key);
+        cached_reply = renew_token ? NULL :
+            signon_context_lookup_token (priv->context, key);
+        if (cached_reply != NULL)
+        {
+            DEBUG ("Reply served from the token cache");
+            g_task_return_pointer (res, cached_reply,
+                                   (GDestroyNotify) g_variant_unref);
+            g_object_unref (res);
+            g_free (key);
+            return;
+        }
+    }
+
+    if (priv->flags & SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE)
+    {
+        /* A request for a new token must not get the reply of a call which
+         * might return the current one */
+        process_data->shared_key = renew_token ?
+            g_strconcat (key, "+renew", NULL) : g_strdup (key);
+        if (signon_context_join_process (priv->context,
+                                         process_data->shared_key, res))
+        {
+            DEBUG ("Sharing the reply of an identical request");
+            auth_session_process_watch (res);
+            g_object_unref (res);
+            g_free (key);
+            return;
+        }
+    }
+
+    g_free (key);
+    auth_session_process_dispatch (res);
 }
 
 /**
@@ -649,6 +1460,17 @@ signon_auth_session_cancel (SignonAuthSession *self)
 
     g_return_if_fail (priv != NULL);
 
+    /* The queued requests are cancelled as well */
+    while (!g_queue_is_empty (&priv->pending))
+    {
+        GTask *res = auth_session_pop_pending (self);
+        auth_session_process_return (res, NULL,
+                                     g_error_new (signon_error_quark (),
+                                                  SIGNON_ERROR_SESSION_CANCELED,
+                                                  "Authentication session was canceled"));
+        g_object_unref (res);
+    }
+
     if (!priv->busy)
         return;
 
@@ -659,6 +1481,54 @@ signon_auth_session_cancel (SignonAuthSession *self)
                                   NULL);
 }
 
+static void
+auth_session_set_proxy (SignonAuthSession *self, SsoAuthSession *proxy)
+{
+    SignonAuthSessionPrivate *priv = self->priv;
+
+    priv->proxy = proxy;
+
+    g_dbus_proxy_set_default_timeout ((GDBusProxy *)priv->proxy,
+                                      G_MAXINT);
+
+    priv->signal_state_changed =
+        g_signal_connect (priv->proxy,
+                          "state-changed",
+                          G_CALLBACK (auth_session_state_changed_cb),
+                          self);
+
+    priv->signal_unregistered =
+       g_signal_connect (priv->proxy,
+                         "unregistered",
+                         G_CALLBACK (auth_session_remote_object_destroyed_cb),
+                         self);
+}
+
+static void
+auth_session_proxy_new_cb (GObject *object, GAsyncResult *res,
+                           gpointer userdata)
+{
+    SsoAuthSession *proxy;
+    GError *error = NULL;
+
+    proxy = sso_auth_session_proxy_new_finish (res, &error);
+    SIGNON_RETURN_IF_CANCELLED (error);
+
+    g_return_if_fail (SIGNON_IS_AUTH_SESSION (userdata));
+    SignonAuthSession *self = SIGNON_AUTH_SESSION (userdata);
+    SignonAuthSessionPrivate *priv = self->priv;
+    g_return_if_fail (priv != NULL);
+
+    priv->registering = FALSE;
+    if (G_LIKELY (error == NULL))
+        auth_session_set_proxy (self, proxy);
+    else
+        g_warning ("Failed to initialize AuthSession proxy: %s",
+                   error->message);
+
+    signon_proxy_set_ready (self, auth_session_object_quark (), error);
+}
+
 static void
 auth_session_get_object_path_reply (GObject *object, GAsyncResult *res,
                                     gpointer userdata)
@@ -678,58 +1548,33 @@ auth_session_get_object_path_reply (GObject *object, GAsyncResult *res,
     SignonAuthSessionPrivate *priv = self->priv;
     g_return_if_fail (priv != NULL);
 
-    priv->registering = FALSE;
+    DEBUG ("Object path received: %s", object_path);
     if (!g_strcmp0(object_path, "") || error)
     {
+        priv->registering = FALSE;
         if (error)
             DEBUG ("Error message is %s", error->message);
         else
             error = g_error_new (signon_error_quark(),
                                  SIGNON_ERROR_RUNTIME,
                                  "Cannot create remote AuthSession object");
-    }
-    else
-    {
-        GDBusConnection *connection;
-        const gchar *bus_name;
-        GError *proxy_error = NULL;
-
-        connection = g_dbus_proxy_get_connection ((GDBusProxy *)proxy);
-        bus_name = g_dbus_proxy_get_name ((GDBusProxy *)proxy);
-
-        priv->proxy =
-            sso_auth_session_proxy_new_sync (connection,
-                                             G_DBUS_PROXY_FLAGS_NONE,
-                                             bus_name,
-                                             object_path,
-                                             priv->cancellable,
-                                             &proxy_error);
-        if (G_UNLIKELY (proxy_error != NULL))
-        {
-            g_warning ("Failed to initialize AuthSession proxy: %s",
-                       proxy_error->message);
-            g_clear_error (&proxy_error);
-        }
-
-        g_dbus_proxy_set_default_timeout ((GDBusProxy *)priv->proxy,
-                                          G_MAXINT);
 
-        priv->signal_state_changed =
-            g_signal_connect (priv->proxy,
-                              "state-changed",
-                              G_CALLBACK (auth_session_state_changed_cb),
-                              self);
-
-        priv->signal_unregistered =
-           g_signal_connect (priv->proxy,
-                             "unregistered",
-                             G_CALLBACK (auth_session_remote_object_destroyed_cb),
-                             self);
+        g_free (object_path);
+        signon_proxy_set_ready (self, auth_session_object_quark (), error);
+        return;
     }
 
-    DEBUG ("Object path received: %s", object_path);
+    /* The AuthSession interface has no properties: don't waste a round trip
+     * in loading them. The session stays in the registering state until the
+     * proxy is ready. */
+    sso_auth_session_proxy_new (g_dbus_proxy_get_connection ((GDBusProxy *)proxy),
+                                G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+                                g_dbus_proxy_get_name ((GDBusProxy *)proxy),
+                                object_path,
+                                priv->cancellable,
+                                auth_session_proxy_new_cb,
+                                self);
     g_free (object_path);
-    signon_proxy_set_ready (self, auth_session_object_quark (), error);
 }
 
 static void
@@ -873,9 +1718,38 @@ auth_session_cancel_ready_cb (gpointer object, const GError *error, gpointer use
     priv->canceled = FALSE;
 }
 
+static void
+auth_session_auth_service_ready_cb (GObject *object, GAsyncResult *res,
+                                    gpointer userdata)
+{
+    SsoAuthService *auth_service_proxy;
+    GError *error = NULL;
+
+    auth_service_proxy = sso_auth_service_get_instance_finish (res, &error);
+    SIGNON_RETURN_IF_CANCELLED (error);
+
+    g_return_if_fail (SIGNON_IS_AUTH_SESSION (userdata));
+    SignonAuthSession *self = SIGNON_AUTH_SESSION (userdata);
+    SignonAuthSessionPrivate *priv = self->priv;
+    g_return_if_fail (priv != NULL);
+
+    priv->registering = FALSE;
+    if (G_UNLIKELY (error != NULL))
+    {
+        DEBUG ("Error message is %s", error->message);
+        signon_proxy_set_ready (self, auth_session_object_quark (), error);
+        return;
+    }
+
+    priv->auth_service_proxy = auth_service_proxy;
+    auth_session_check_remote_object (self);
+}
+
 static void
 auth_session_check_remote_object(SignonAuthSession *self)
 {
+    GDBusProxy *pooled;
+
     g_return_if_fail (self != NULL);
     SignonAuthSessionPrivate *priv = self->priv;
     g_return_if_fail (priv != NULL);
@@ -883,11 +1757,32 @@ auth_session_check_remote_object(SignonAuthSession *self)
     if (priv->proxy != NULL)
         return;
 
-    g_return_if_fail (priv->auth_service_proxy != NULL);
-
     if (!priv->registering)
     {
+        pooled = priv->id != 0 ?
+            signon_context_take_auth_session (priv->context, priv->id,
+                                              priv->method_name) : NULL;
+        if (pooled != NULL)
+        {
+            DEBUG ("Reusing an idle remote session");
+            auth_session_set_proxy (self, SSO_AUTH_SESSION (pooled));
+            signon_proxy_set_ready (self, auth_session_object_quark (), NULL);
+            return;
+        }
+
         priv->registering = TRUE;
+
+        if (priv->auth_service_proxy == NULL)
+        {
+            /* The registration will continue once the AuthService proxy is
+             * available */
+            sso_auth_service_get_instance_async (priv->context,
+                                                 priv->cancellable,
+                                                 auth_session_auth_service_ready_cb,
+                                                 self);
+            return;
+        }
+
         sso_auth_service_call_get_auth_session_object_path (
             priv->auth_service_proxy,
             priv->id,
@@ -28,6 +28,7 @@
 
 #include <gio/gio.h>
 #include <glib-object.h>
+#include <libsignon-glib/signon-context.h>
 #include <libsignon-glib/signon-types.h>
 
 G_BEGIN_DECLS
@@ -108,6 +109,48 @@ typedef enum {
  */
 #define SIGNON_SESSION_DATA_RENEW_TOKEN   "RenewToken"
 
+/**
+ * SignonAuthSessionFlags:
+ * @SIGNON_AUTH_SESSION_FLAG_NONE: no flags.
+ * @SIGNON_AUTH_SESSION_FLAG_PREFETCH: start setting up the remote session as
+ * soon as the #SignonAuthSession is created, instead of waiting for its first
+ * request.
+ * @SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE: let signon_auth_session_process_async()
+ * share the reply of an identical request which is already in progress on a
+ * session bound to the same identity and method, instead of sending a new one
+ * to signond. Both sessions must have been created with this flag.
+ *
+ * Flags for signon_auth_session_new_full() and
+ * signon_identity_create_session_with_flags().
+ *
+ * Since: 1.15
+ */
+typedef enum {
+    SIGNON_AUTH_SESSION_FLAG_NONE = 0,
+    SIGNON_AUTH_SESSION_FLAG_PREFETCH = 1 << 0,
+    SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE = 1 << 1,
+} SignonAuthSessionFlags;
+
+/**
+ * SignonPriority:
+ * @SIGNON_PRIORITY_BACKGROUND: work which nobody is waiting for, such as
+ * refreshing tokens ahead of time. It is held back while interactive
+ * requests are pending.
+ * @SIGNON_PRIORITY_DEFAULT: the default priority.
+ * @SIGNON_PRIORITY_INTERACTIVE: requests which the user is waiting for, such
+ * as a sign-in.
+ *
+ * The priority of the requests of a #SignonAuthSession: when they have to be
+ * queued (see #SignonContext:max-in-flight), requests with a higher priority
+ * are sent first.
+ *
+ * Since: 1.15
+ */
+typedef enum {
+    SIGNON_PRIORITY_BACKGROUND = -1,
+    SIGNON_PRIORITY_DEFAULT = 0,
+    SIGNON_PRIORITY_INTERACTIVE = 1,
+} SignonPriority;
 
 #define SIGNON_TYPE_AUTH_SESSION                 (signon_auth_session_get_type ())
 #define SIGNON_AUTH_SESSION(obj)                 (G_TYPE_CHECK_INSTANCE_CAST ((obj), SIGNON_TYPE_AUTH_SESSION, SignonAuthSession))
@@ -145,8 +188,22 @@ GType signon_auth_session_get_type (void) G_GNUC_CONST;
 SignonAuthSession *signon_auth_session_new(gint id,
                                            const gchar *method_name,
                                            GError **err);
+SignonAuthSession *signon_auth_session_new_with_context (SignonContext *context,
+                                                         gint id,
+                                                         const gchar *method_name,
+                                                         GError **err);
+SignonAuthSession *signon_auth_session_new_full (SignonContext *context,
+                                                 gint id,
+                                                 const gchar *method_name,
+                                                 SignonAuthSessionFlags flags,
+                                                 GError **err);
 
 const gchar *signon_auth_session_get_method (SignonAuthSession *self);
+guint signon_auth_session_get_queue_depth (SignonAuthSession *self);
+
+SignonPriority signon_auth_session_get_priority (SignonAuthSession *self);
+void signon_auth_session_set_priority (SignonAuthSession *self,
+                                       SignonPriority priority);
 
 typedef void (*SignonAuthSessionQueryAvailableMechanismsCb) (
                     SignonAuthSession* self,
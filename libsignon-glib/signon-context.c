@@ -0,0 +1,1626 @@
+/* vi: set et sw=4 ts=4 cino=t0,(0: */
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This file is part of libsignon-glib
+ *
+ * Copyright (C) 2012-2018 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/**
+ * SECTION:signon-context
+ * @title: SignonContext
+ * @short_description: Connection to the signon daemon.
+ *
+ * The #SignonContext holds the D-Bus connection to the signon daemon and the
+ * state which can be shared among the #SignonIdentity, #SignonAuthSession and
+ * #SignonAuthService objects created with it.
+ *
+ * Objects created with the constructors which don't take a context use the
+ * default context returned by signon_context_get_default(). Applications
+ * which already have a #GDBusConnection open, or which want several isolated
+ * instances in the same process, can create their own context with
+ * signon_context_new(); peer-to-peer connections are supported as well.
+ *
+ * signon_context_new_for_address() creates a context which talks to signond
+ * directly over a private peer-to-peer connection, saving the hop through the
+ * bus daemon. If that connection cannot be established, the context falls
+ * back to the session bus.
+ */
+
+#include "signon-context.h"
+#include "signon-errors.h"
+#include "signon-internals.h"
+#include "signon-utils.h"
+#include "sso-auth-service.h"
+
+G_DEFINE_TYPE (SignonContext, signon_context, G_TYPE_OBJECT);
+
+enum
+{
+    PROP_0,
+    PROP_CONNECTION,
+    PROP_ADDRESS,
+    PROP_QUERY_CACHE_TTL,
+    PROP_SESSION_POOL_SIZE,
+    PROP_SESSION_POOL_IDLE_TIMEOUT,
+    PROP_TOKEN_CACHE_TTL,
+    PROP_MAX_IN_FLIGHT
+};
+
+#define DEFAULT_QUERY_CACHE_TTL 60
+#define DEFAULT_SESSION_POOL_IDLE_TIMEOUT 10
+/* Expired tokens are only looked for once the cache grows past this size */
+#define TOKEN_CACHE_PRUNE_THRESHOLD 64
+/* Background calls in flight while interactive requests are pending */
+#define THROTTLED_BACKGROUND_IN_FLIGHT 1
+
+/* Cached result of QueryMethods or QueryMechanisms */
+typedef struct {
+    gchar **value;
+    gint64 expiry;
+    /* GTasks waiting for the in-flight call, most recent first */
+    GSList *waiters;
+} QueryCacheEntry;
+
+/* Reply of an authentication session */
+typedef struct {
+    GVariant *reply;
+    gint64 expiry;
+    guint32 id;
+} TokenCacheEntry;
+
+struct _SignonContextPrivate
+{
+    GDBusConnection *connection;
+    /* Address for a peer-to-peer connection to signond */
+    gchar *address;
+    /* Set if the connection was opened by the context itself */
+    guint closed_id;
+    /* TRUE for the contexts returned by signon_context_get_default() */
+    gboolean is_default;
+
+    GWeakRef auth_service_ref;
+    /* Owned reference, for the contexts created by the client */
+    SsoAuthService *auth_service;
+
+    /* Protects the fields below, if several threads share a context */
+    GMutex mutex;
+    /* GTasks waiting for the proxy creation to complete */
+    GSList *pending_tasks;
+    gboolean pending;
+
+    /* The caches below are only used from the main context of the objects
+     * using this SignonContext. */
+    guint query_cache_ttl;
+    /* Bumped on every invalidation, to discard in-flight results */
+    guint query_cache_generation;
+    QueryCacheEntry methods_cache;
+    /* method name -> QueryCacheEntry */
+    GHashTable *mechanisms_cache;
+    /* identity id -> SignonIdentityInfoEntry, for the live identities */
+    GHashTable *identity_info_cache;
+    /* identity id -> SignonIdentity (not owned), for the identities
+     * returned by signon_identity_get_from_db() */
+    GHashTable *interned_identities;
+    /* Idle remote AuthSession objects (PooledSession), most recently
+     * released first */
+    GQueue session_pool;
+    guint session_pool_size;
+    guint session_pool_idle_timeout;
+    /* token cache key -> TokenCacheEntry */
+    GHashTable *token_cache;
+    guint token_cache_ttl;
+    /* process key -> GQueue of the GTasks waiting for the in-flight call */
+    GHashTable *shared_processes;
+    /* Process calls sent to signond, by priority lane, and the maximum
+     * allowed in total (0 for no limit) */
+    guint in_flight[SIGNON_PRIORITY_N_LANES];
+    guint max_in_flight;
+    /* SignonAuthSessions waiting for an in-flight slot, in order */
+    GQueue slot_waiters[SIGNON_PRIORITY_N_LANES];
+    /* Requests of all the sessions which haven't been sent yet */
+    guint queue_depth[SIGNON_PRIORITY_N_LANES];
+};
+
+/* A remote AuthSession object which is no longer used by any
+ * SignonAuthSession, and can be handed to a new one */
+typedef struct {
+    SignonContext *context;
+    GDBusProxy *proxy;
+    guint32 id;
+    gchar *method;
+    gulong unregistered_id;
+    GSource *timeout_source;
+} PooledSession;
+
+typedef struct {
+    SignonContext *context;
+    /* NULL for QueryMethods */
+    gchar *method;
+    guint generation;
+} QueryData;
+
+/* The default SignonContext is shared by all the objects living in the same
+ * GMainContext, since that is where GDBus dispatches its replies and signals.
+ *
+ * Registry entries are created on first use and removed when their
+ * GMainContext is finalized: a dummy GSource attached to the main context is
+ * destroyed together with it, and its finalize function drops the entry.
+ * Since the AuthService proxy keeps its main context alive (through its
+ * signal subscriptions), default contexts only hold it through a weak
+ * reference.
+ *
+ * Lookups go through a per-thread cache of the last entry used, which is
+ * validated against a global generation counter, bumped whenever an entry is
+ * removed; the map mutex is only taken on a cache miss. A cached entry can be
+ * used without locking because it belongs to the thread-default context of
+ * the calling thread, which is kept alive for as long as it is pushed.
+ */
+typedef struct {
+    GSource source;
+    GMainContext *main_context;
+} ContextWatch;
+
+typedef struct {
+    GMainContext *main_context;
+    SignonContext *context;
+    gint generation;
+} ThreadCache;
+
+static GHashTable *default_contexts = NULL;
+static GMutex map_mutex;
+static gint registry_generation = 0;
+
+static GPrivate thread_cache = G_PRIVATE_INIT (g_free);
+
+static void
+query_cache_entry_free (QueryCacheEntry *entry)
+{
+    g_strfreev (entry->value);
+    g_slice_free (QueryCacheEntry, entry);
+}
+
+static void
+token_cache_entry_free (TokenCacheEntry *entry)
+{
+    g_variant_unref (entry->reply);
+    g_slice_free (TokenCacheEntry, entry);
+}
+
+static void
+process_waiters_free (GQueue *waiters)
+{
+    g_queue_free_full (waiters, g_object_unref);
+}
+
+static void
+identity_info_entry_free (SignonIdentityInfoEntry *entry)
+{
+    if (entry->info != NULL)
+        signon_identity_info_free (entry->info);
+    g_slice_free (SignonIdentityInfoEntry, entry);
+}
+
+static void
+pooled_session_free (PooledSession *pooled)
+{
+    g_signal_handler_disconnect (pooled->proxy, pooled->unregistered_id);
+    if (pooled->timeout_source != NULL)
+    {
+        g_source_destroy (pooled->timeout_source);
+        g_source_unref (pooled->timeout_source);
+    }
+    g_object_unref (pooled->proxy);
+    g_free (pooled->method);
+    g_slice_free (PooledSession, pooled);
+}
+
+static void
+pooled_session_discard (PooledSession *pooled)
+{
+    g_queue_remove (&pooled->context->priv->session_pool, pooled);
+    pooled_session_free (pooled);
+}
+
+static void
+pooled_session_unregistered_cb (GDBusProxy *proxy, gpointer user_data)
+{
+    DEBUG ("Pooled remote session unregistered");
+    pooled_session_discard (user_data);
+}
+
+static gboolean
+pooled_session_timeout_cb (gpointer user_data)
+{
+    PooledSession *pooled = user_data;
+
+    DEBUG ("Pooled remote session expired");
+    /* The source is being dispatched: let GLib destroy it */
+    g_source_unref (pooled->timeout_source);
+    pooled->timeout_source = NULL;
+    pooled_session_discard (pooled);
+    return G_SOURCE_REMOVE;
+}
+
+/* Drops the least recently released sessions, until at most @size are
+ * left */
+static void
+context_session_pool_trim (SignonContext *self, guint size)
+{
+    GQueue *pool = &self->priv->session_pool;
+
+    while (g_queue_get_length (pool) > size)
+        pooled_session_free (g_queue_pop_tail (pool));
+}
+
+static void
+context_query_cache_invalidate (SignonContext *self)
+{
+    SignonContextPrivate *priv = self->priv;
+    GHashTableIter iter;
+    QueryCacheEntry *entry;
+
+    DEBUG ("Invalidating the query cache");
+    priv->query_cache_generation++;
+
+    g_clear_pointer (&priv->methods_cache.value, g_strfreev);
+
+    /* Entries with an in-flight call must stay, to keep the waiters */
+    g_hash_table_iter_init (&iter, priv->mechanisms_cache);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry))
+    {
+        if (entry->waiters == NULL)
+            g_hash_table_iter_remove (&iter);
+        else
+            g_clear_pointer (&entry->value, g_strfreev);
+    }
+}
+
+/* Returns TRUE if a request of the given lane can be sent now */
+static gboolean
+context_lane_can_run (SignonContext *self, guint lane)
+{
+    SignonContextPrivate *priv = self->priv;
+    guint in_flight = 0;
+    guint i;
+
+    for (i = 0; i < SIGNON_PRIORITY_N_LANES; i++)
+        in_flight += priv->in_flight[i];
+    if (priv->max_in_flight != 0 && in_flight >= priv->max_in_flight)
+        return FALSE;
+
+    /* Requests with a higher priority go first */
+    for (i = lane + 1; i < SIGNON_PRIORITY_N_LANES; i++)
+    {
+        if (!g_queue_is_empty (&priv->slot_waiters[i]))
+            return FALSE;
+    }
+
+    /* Background work gives way to interactive requests */
+    if (lane == SIGNON_PRIORITY_LANE (SIGNON_PRIORITY_BACKGROUND))
+    {
+        guint interactive = SIGNON_PRIORITY_LANE (SIGNON_PRIORITY_INTERACTIVE);
+
+        if (priv->queue_depth[interactive] + priv->in_flight[interactive] > 0 &&
+            priv->in_flight[lane] >= THROTTLED_BACKGROUND_IN_FLIGHT)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+context_run_slot_waiters (SignonContext *self)
+{
+    SignonContextPrivate *priv = self->priv;
+    SignonAuthSession *session;
+    gint lane;
+
+    for (lane = SIGNON_PRIORITY_N_LANES - 1; lane >= 0; lane--)
+    {
+        while (context_lane_can_run (self, lane) &&
+               (session = g_queue_pop_head (&priv->slot_waiters[lane])) != NULL)
+        {
+            signon_auth_session_process_next (session);
+            g_object_unref (session);
+        }
+
+        /* The lower lanes must wait */
+        if (!g_queue_is_empty (&priv->slot_waiters[lane])) break;
+    }
+}
+
+static void
+signon_context_set_property (GObject *object,
+                             guint property_id,
+                             const GValue *value,
+                             GParamSpec *pspec)
+{
+    SignonContext *self = SIGNON_CONTEXT (object);
+
+    switch (property_id)
+    {
+    case PROP_CONNECTION:
+        self->priv->connection = g_value_dup_object (value);
+        break;
+    case PROP_ADDRESS:
+        self->priv->address = g_value_dup_string (value);
+        break;
+    case PROP_QUERY_CACHE_TTL:
+        self->priv->query_cache_ttl = g_value_get_uint (value);
+        if (self->priv->query_cache_ttl == 0)
+            context_query_cache_invalidate (self);
+        break;
+    case PROP_SESSION_POOL_SIZE:
+        self->priv->session_pool_size = g_value_get_uint (value);
+        context_session_pool_trim (self, self->priv->session_pool_size);
+        break;
+    case PROP_SESSION_POOL_IDLE_TIMEOUT:
+        self->priv->session_pool_idle_timeout = g_value_get_uint (value);
+        break;
+    case PROP_TOKEN_CACHE_TTL:
+        self->priv->token_cache_ttl = g_value_get_uint (value);
+        if (self->priv->token_cache_ttl == 0)
+            g_hash_table_remove_all (self->priv->token_cache);
+        break;
+    case PROP_MAX_IN_FLIGHT:
+        self->priv->max_in_flight = g_value_get_uint (value);
+        context_run_slot_waiters (self);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+        break;
+    }
+}
+
+static void
+signon_context_get_property (GObject *object,
+                             guint property_id,
+                             GValue *value,
+                             GParamSpec *pspec)
+{
+    SignonContext *self = SIGNON_CONTEXT (object);
+
+    switch (property_id)
+    {
+    case PROP_CONNECTION:
+        g_value_set_object (value, signon_context_get_connection (self));
+        break;
+    case PROP_ADDRESS:
+        g_value_set_string (value, self->priv->address);
+        break;
+    case PROP_QUERY_CACHE_TTL:
+        g_value_set_uint (value, self->priv->query_cache_ttl);
+        break;
+    case PROP_SESSION_POOL_SIZE:
+        g_value_set_uint (value, self->priv->session_pool_size);
+        break;
+    case PROP_SESSION_POOL_IDLE_TIMEOUT:
+        g_value_set_uint (value, self->priv->session_pool_idle_timeout);
+        break;
+    case PROP_TOKEN_CACHE_TTL:
+        g_value_set_uint (value, self->priv->token_cache_ttl);
+        break;
+    case PROP_MAX_IN_FLIGHT:
+        g_value_set_uint (value, self->priv->max_in_flight);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+        break;
+    }
+}
+
+static void
+signon_context_init (SignonContext *self)
+{
+    SignonContextPrivate *priv;
+    guint i;
+
+    priv = G_TYPE_INSTANCE_GET_PRIVATE (self, SIGNON_TYPE_CONTEXT,
+                                        SignonContextPrivate);
+    self->priv = priv;
+
+    g_weak_ref_init (&priv->auth_service_ref, NULL);
+    g_mutex_init (&priv->mutex);
+
+    priv->mechanisms_cache =
+        g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                               (GDestroyNotify) query_cache_entry_free);
+    priv->identity_info_cache =
+        g_hash_table_new_full (NULL, NULL, NULL,
+                               (GDestroyNotify) identity_info_entry_free);
+    priv->interned_identities = g_hash_table_new (NULL, NULL);
+    g_queue_init (&priv->session_pool);
+    priv->token_cache =
+        g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                               (GDestroyNotify) token_cache_entry_free);
+    priv->shared_processes =
+        g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                               (GDestroyNotify) process_waiters_free);
+    for (i = 0; i < SIGNON_PRIORITY_N_LANES; i++)
+        g_queue_init (&priv->slot_waiters[i]);
+}
+
+static void
+signon_context_dispose (GObject *object)
+{
+    SignonContext *self = SIGNON_CONTEXT (object);
+    SignonContextPrivate *priv = self->priv;
+    guint i;
+
+    context_session_pool_trim (self, 0);
+    for (i = 0; i < SIGNON_PRIORITY_N_LANES; i++)
+    {
+        while (!g_queue_is_empty (&priv->slot_waiters[i]))
+            g_object_unref (g_queue_pop_head (&priv->slot_waiters[i]));
+    }
+    g_clear_object (&priv->auth_service);
+    if (priv->closed_id != 0)
+    {
+        g_signal_handler_disconnect (priv->connection, priv->closed_id);
+        priv->closed_id = 0;
+    }
+    g_clear_object (&priv->connection);
+
+    G_OBJECT_CLASS (signon_context_parent_class)->dispose (object);
+}
+
+static void
+signon_context_finalize (GObject *object)
+{
+    SignonContext *self = SIGNON_CONTEXT (object);
+    SignonContextPrivate *priv = self->priv;
+
+    g_weak_ref_clear (&priv->auth_service_ref);
+    g_mutex_clear (&priv->mutex);
+    g_free (priv->address);
+    g_strfreev (priv->methods_cache.value);
+    g_hash_table_unref (priv->mechanisms_cache);
+    g_hash_table_unref (priv->identity_info_cache);
+    g_hash_table_unref (priv->interned_identities);
+    g_hash_table_unref (priv->token_cache);
+    g_hash_table_unref (priv->shared_processes);
+
+    G_OBJECT_CLASS (signon_context_parent_class)->finalize (object);
+}
+
+static void
+signon_context_class_init (SignonContextClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (SignonContextPrivate));
+
+    object_class->set_property = signon_context_set_property;
+    object_class->get_property = signon_context_get_property;
+    object_class->dispose = signon_context_dispose;
+    object_class->finalize = signon_context_finalize;
+
+    /**
+     * SignonContext:connection:
+     *
+     * The #GDBusConnection to the signon daemon. If %NULL at construction
+     * time, the session bus will be used, and the property will be set once
+     * the connection is established.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_CONNECTION,
+        g_param_spec_object ("connection",
+                             "Connection",
+                             "D-Bus connection to the signon daemon",
+                             G_TYPE_DBUS_CONNECTION,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+                             G_PARAM_STATIC_STRINGS));
+
+    /**
+     * SignonContext:address:
+     *
+     * The D-Bus address of signond, for a peer-to-peer connection. If the
+     * connection to this address fails, the session bus is used instead.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_ADDRESS,
+        g_param_spec_string ("address",
+                             "Address",
+                             "D-Bus address for a peer-to-peer connection",
+                             NULL,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+                             G_PARAM_STATIC_STRINGS));
+
+    /**
+     * SignonContext:query-cache-ttl:
+     *
+     * How long (in seconds) the results of
+     * signon_auth_service_query_methods() and
+     * signon_auth_service_query_mechanisms() are cached. The cache is also
+     * invalidated whenever signond is restarted. Set to 0 to disable the
+     * cache.
+     *
+     * On the default context, the cached results are dropped as soon as no
+     * object is using the connection to signond any more.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_QUERY_CACHE_TTL,
+        g_param_spec_uint ("query-cache-ttl",
+                           "Query cache TTL",
+                           "Lifetime of cached methods and mechanisms",
+                           0, G_MAXUINT, DEFAULT_QUERY_CACHE_TTL,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
+                           G_PARAM_STATIC_STRINGS));
+
+    /**
+     * SignonContext:session-pool-size:
+     *
+     * How many idle remote authentication sessions are kept for reuse. When
+     * a #SignonAuthSession which is not processing any request is
+     * destroyed, its remote session object is kept in a pool, and handed to
+     * the next #SignonAuthSession created for the same identity and method;
+     * this saves the latter the creation of the remote object. Sessions
+     * which are not bound to a stored identity are never pooled. The default
+     * is 0, which disables the pool.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_SESSION_POOL_SIZE,
+        g_param_spec_uint ("session-pool-size",
+                           "Session pool size",
+                           "Maximum number of idle remote sessions kept",
+                           0, G_MAXUINT, 0,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
+                           G_PARAM_STATIC_STRINGS));
+
+    /**
+     * SignonContext:session-pool-idle-timeout:
+     *
+     * How long (in seconds) an idle remote authentication session is kept in
+     * the pool (see #SignonContext:session-pool-size). Sessions which signond
+     * destroys are removed from the pool earlier.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class,
+                                     PROP_SESSION_POOL_IDLE_TIMEOUT,
+        g_param_spec_uint ("session-pool-idle-timeout",
+                           "Session pool idle timeout",
+                           "Lifetime of the idle remote sessions",
+                           1, G_MAXUINT, DEFAULT_SESSION_POOL_IDLE_TIMEOUT,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
+                           G_PARAM_STATIC_STRINGS));
+
+    /**
+     * SignonContext:token-cache-ttl:
+     *
+     * How long (in seconds) the replies of signon_auth_session_process_async()
+     * are cached. A request for the same identity, method and mechanism, and
+     * with the same session data (ignoring the keys which only affect the
+     * user interaction, such as %SIGNON_SESSION_DATA_WINDOW_ID), is then
+     * served from the cache. Replies which carry an "ExpiresIn" value are
+     * not kept longer than that. Requests setting
+     * %SIGNON_SESSION_DATA_RENEW_TOKEN always reach signond. The cache is
+     * also invalidated when the identity changes or is signed out. The
+     * default is 0, which disables the cache.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_TOKEN_CACHE_TTL,
+        g_param_spec_uint ("token-cache-ttl",
+                           "Token cache TTL",
+                           "Maximum lifetime of cached authentication replies",
+                           0, G_MAXUINT, 0,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
+                           G_PARAM_STATIC_STRINGS));
+
+    /**
+     * SignonContext:max-in-flight:
+     *
+     * The maximum number of signon_auth_session_process_async() requests
+     * which can be handled by signond at the same time, across all the
+     * #SignonAuthSession objects using this context. The other requests are
+     * queued, and sent in order as soon as the previous ones complete; see
+     * signon_context_get_queue_depth(). Regardless of this limit, each
+     * #SignonAuthSession only has one request in progress at any time. The
+     * default is 0, which means no limit.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_MAX_IN_FLIGHT,
+        g_param_spec_uint ("max-in-flight",
+                           "Maximum in-flight requests",
+                           "Maximum number of requests being processed",
+                           0, G_MAXUINT, 0,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
+                           G_PARAM_STATIC_STRINGS));
+}
+
+/**
+ * signon_context_new:
+ * @connection: (allow-none): a #GDBusConnection to the signon daemon, or
+ * %NULL to use the session bus.
+ *
+ * Creates a new #SignonContext. @connection can be a message bus connection
+ * (in which case signond is reached through its well-known name) or a
+ * peer-to-peer connection to signond.
+ *
+ * Returns: (transfer full): a new #SignonContext.
+ *
+ * Since: 1.15
+ */
+SignonContext *
+signon_context_new (GDBusConnection *connection)
+{
+    g_return_val_if_fail (connection == NULL ||
+                          G_IS_DBUS_CONNECTION (connection), NULL);
+
+    return g_object_new (SIGNON_TYPE_CONTEXT,
+                         "connection", connection,
+                         NULL);
+}
+
+/**
+ * signon_context_new_for_address:
+ * @address: a D-Bus address where signond accepts peer-to-peer connections.
+ *
+ * Creates a new #SignonContext which talks to signond over a private
+ * peer-to-peer connection to @address. The connection is established when
+ * first needed; if it fails, the context transparently uses the session bus
+ * instead. If the connection gets closed (for instance, because signond
+ * exited), a new one is opened on the next request.
+ *
+ * Returns: (transfer full): a new #SignonContext.
+ *
+ * Since: 1.15
+ */
+SignonContext *
+signon_context_new_for_address (const gchar *address)
+{
+    g_return_val_if_fail (address != NULL, NULL);
+
+    return g_object_new (SIGNON_TYPE_CONTEXT,
+                         "address", address,
+                         NULL);
+}
+
+static gboolean
+context_watch_dispatch (GSource *source, GSourceFunc callback,
+                        gpointer user_data)
+{
+    /* Never reached: the source never becomes ready */
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+context_watch_finalize (GSource *source)
+{
+    ContextWatch *watch = (ContextWatch *)source;
+    SignonContext *context;
+
+    g_mutex_lock (&map_mutex);
+    g_atomic_int_inc (&registry_generation);
+    context = g_hash_table_lookup (default_contexts, watch->main_context);
+    g_hash_table_steal (default_contexts, watch->main_context);
+    g_mutex_unlock (&map_mutex);
+
+    if (context != NULL)
+        g_object_unref (context);
+}
+
+static GSourceFuncs context_watch_funcs = {
+    NULL,
+    NULL,
+    context_watch_dispatch,
+    context_watch_finalize,
+};
+
+static void
+context_watch_attach (GMainContext *main_context)
+{
+    ContextWatch *watch;
+
+    watch = (ContextWatch *)g_source_new (&context_watch_funcs,
+                                          sizeof (ContextWatch));
+    watch->main_context = main_context;
+    g_source_set_name ((GSource *)watch, "[libsignon-glib] context watch");
+    g_source_attach ((GSource *)watch, main_context);
+    /* The main context holds the only reference now */
+    g_source_unref ((GSource *)watch);
+}
+
+/**
+ * signon_context_get_default:
+ *
+ * Gets the default #SignonContext for the thread-default #GMainContext
+ * (see g_main_context_push_thread_default()). It uses the session bus, and
+ * it is released once its #GMainContext is destroyed.
+ *
+ * Returns: (transfer none): the default #SignonContext.
+ *
+ * Since: 1.15
+ */
+SignonContext *
+signon_context_get_default ()
+{
+    GMainContext *main_context;
+    SignonContext *context;
+    ThreadCache *cache;
+    gint generation;
+
+    main_context = g_main_context_get_thread_default ();
+    if (main_context == NULL)
+        main_context = g_main_context_default ();
+
+    generation = g_atomic_int_get (&registry_generation);
+    cache = g_private_get (&thread_cache);
+    if (cache != NULL &&
+        cache->main_context == main_context &&
+        cache->generation == generation)
+        return cache->context;
+
+    g_mutex_lock (&map_mutex);
+
+    if (default_contexts == NULL)
+    {
+        default_contexts =
+            g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                   NULL, g_object_unref);
+    }
+
+    context = g_hash_table_lookup (default_contexts, main_context);
+    if (context == NULL)
+    {
+        context = g_object_new (SIGNON_TYPE_CONTEXT, NULL);
+        context->priv->is_default = TRUE;
+        g_hash_table_insert (default_contexts, main_context, context);
+        context_watch_attach (main_context);
+    }
+
+    generation = g_atomic_int_get (&registry_generation);
+    g_mutex_unlock (&map_mutex);
+
+    if (cache == NULL)
+    {
+        cache = g_new (ThreadCache, 1);
+        g_private_set (&thread_cache, cache);
+    }
+    cache->main_context = main_context;
+    cache->context = context;
+    cache->generation = generation;
+
+    return context;
+}
+
+/**
+ * signon_context_get_connection:
+ * @self: the #SignonContext.
+ *
+ * Gets the D-Bus connection used by @self.
+ *
+ * Returns: (transfer none): the #GDBusConnection, or %NULL if the context
+ * was created without one and hasn't connected to the session bus yet.
+ *
+ * Since: 1.15
+ */
+GDBusConnection *
+signon_context_get_connection (SignonContext *self)
+{
+    GDBusConnection *connection;
+
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (self), NULL);
+
+    g_mutex_lock (&self->priv->mutex);
+    connection = self->priv->connection;
+    g_mutex_unlock (&self->priv->mutex);
+    return connection;
+}
+
+/**
+ * signon_context_get_queue_depth:
+ * @self: the #SignonContext.
+ *
+ * Gets the number of signon_auth_session_process_async() requests which are
+ * waiting to be sent to signond, either because their #SignonAuthSession is
+ * busy with a previous request or because of the
+ * #SignonContext:max-in-flight limit.
+ *
+ * Returns: the number of queued requests.
+ *
+ * Since: 1.15
+ */
+guint
+signon_context_get_queue_depth (SignonContext *self)
+{
+    guint queue_depth = 0;
+    guint i;
+
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (self), 0);
+
+    for (i = 0; i < SIGNON_PRIORITY_N_LANES; i++)
+        queue_depth += self->priv->queue_depth[i];
+    return queue_depth;
+}
+
+static void
+context_connection_closed_cb (GDBusConnection *connection,
+                              gboolean remote_peer_vanished,
+                              GError *error,
+                              gpointer user_data)
+{
+    SignonContext *self = user_data;
+    SignonContextPrivate *priv = self->priv;
+
+    DEBUG ("Connection to signond closed");
+
+    /* Forget about the connection: the next request will open a new one */
+    g_mutex_lock (&priv->mutex);
+    g_weak_ref_set (&priv->auth_service_ref, NULL);
+    g_clear_object (&priv->auth_service);
+    g_signal_handler_disconnect (priv->connection, priv->closed_id);
+    priv->closed_id = 0;
+    g_clear_object (&priv->connection);
+    g_mutex_unlock (&priv->mutex);
+
+    context_query_cache_invalidate (self);
+    context_session_pool_trim (self, 0);
+    g_hash_table_remove_all (priv->token_cache);
+}
+
+static void
+context_name_owner_changed_cb (GObject *proxy, GParamSpec *pspec,
+                               gpointer user_data)
+{
+    SignonContext *self = user_data;
+
+    DEBUG ("signond owner changed");
+    context_query_cache_invalidate (self);
+    /* The remote sessions went away with the old signond */
+    context_session_pool_trim (self, 0);
+    g_hash_table_remove_all (self->priv->token_cache);
+}
+
+/* Without the proxy signond restarts go unnoticed, so the cached results
+ * can't be trusted any more */
+static void
+context_auth_service_finalized_cb (gpointer user_data,
+                                   GObject *where_the_object_was)
+{
+    SignonContext *self = user_data;
+
+    DEBUG ("AuthService proxy finalized");
+    context_query_cache_invalidate (self);
+}
+
+static void
+context_set_auth_service (SignonContext *self,
+                          SsoAuthService *sso_auth_service,
+                          GError *error)
+{
+    SignonContextPrivate *priv = self->priv;
+    GSList *tasks, *list;
+
+    g_mutex_lock (&priv->mutex);
+    if (G_LIKELY (error == NULL))
+    {
+        g_weak_ref_set (&priv->auth_service_ref, sso_auth_service);
+        if (!priv->is_default)
+            g_set_object (&priv->auth_service, sso_auth_service);
+        if (priv->connection == NULL)
+        {
+            GDBusProxy *proxy = (GDBusProxy *)sso_auth_service;
+            priv->connection =
+                g_object_ref (g_dbus_proxy_get_connection (proxy));
+            if (priv->address != NULL)
+                priv->closed_id =
+                    g_signal_connect (priv->connection, "closed",
+                                      G_CALLBACK (context_connection_closed_cb),
+                                      self);
+        }
+    }
+    else
+    {
+        g_warning ("Couldn't activate signond: %s", error->message);
+    }
+
+    /* Release all the requests which were queued while the proxy was being
+     * created, in the order they were made. */
+    tasks = g_slist_reverse (priv->pending_tasks);
+    priv->pending_tasks = NULL;
+    priv->pending = FALSE;
+    g_mutex_unlock (&priv->mutex);
+
+    /* While at it, register the error mapping with GDBus */
+    signon_error_quark ();
+
+    /* Nothing needs to be invalidated here: the cache is only filled while
+     * a proxy is alive, and it's emptied when the proxy goes away */
+    if (sso_auth_service != NULL)
+    {
+        /* The default context outlives the proxy, which keeps its main
+         * context alive */
+        if (priv->is_default)
+            g_object_weak_ref ((GObject *)sso_auth_service,
+                               context_auth_service_finalized_cb, self);
+        g_signal_connect_object (sso_auth_service, "notify::g-name-owner",
+                                 G_CALLBACK (context_name_owner_changed_cb),
+                                 self, 0);
+    }
+
+    for (list = tasks; list != NULL; list = list->next)
+    {
+        GTask *task = list->data;
+
+        if (sso_auth_service != NULL)
+            g_task_return_pointer (task, g_object_ref (sso_auth_service),
+                                   g_object_unref);
+        else
+            g_task_return_error (task, g_error_copy (error));
+        g_object_unref (task);
+    }
+    g_slist_free (tasks);
+}
+
+static void
+auth_service_proxy_new_cb (GObject *object, GAsyncResult *res,
+                           gpointer user_data)
+{
+    SignonContext *self = user_data;
+    SsoAuthService *sso_auth_service;
+    GError *error = NULL;
+
+    sso_auth_service = sso_auth_service_proxy_new_finish (res, &error);
+    context_set_auth_service (self, sso_auth_service, error);
+
+    g_clear_object (&sso_auth_service);
+    g_clear_error (&error);
+    g_object_unref (self);
+}
+
+static void
+context_create_auth_service (SignonContext *self,
+                             GDBusConnection *connection)
+{
+    /* signond is reached via its well-known name on a message bus, and
+     * directly on a peer-to-peer connection */
+    sso_auth_service_proxy_new (connection,
+                                G_DBUS_PROXY_FLAGS_NONE,
+                                g_dbus_connection_get_unique_name (connection) ?
+                                SIGNOND_SERVICE : NULL,
+                                SIGNOND_DAEMON_OBJECTPATH,
+                                NULL,
+                                auth_service_proxy_new_cb,
+                                self);
+}
+
+static void
+bus_get_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+    SignonContext *self = user_data;
+    GDBusConnection *connection;
+    GError *error = NULL;
+
+    connection = g_bus_get_finish (res, &error);
+    if (G_UNLIKELY (error != NULL))
+    {
+        context_set_auth_service (self, NULL, error);
+        g_error_free (error);
+        g_object_unref (self);
+        return;
+    }
+
+    context_create_auth_service (self, connection);
+    g_object_unref (connection);
+}
+
+static void
+address_connect_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+    SignonContext *self = user_data;
+    GDBusConnection *connection;
+    GError *error = NULL;
+
+    connection = g_dbus_connection_new_for_address_finish (res, &error);
+    if (G_UNLIKELY (error != NULL))
+    {
+        DEBUG ("Peer-to-peer connection to %s failed (%s), "
+               "falling back to the session bus",
+               self->priv->address, error->message);
+        g_error_free (error);
+        g_bus_get (G_BUS_TYPE_SESSION, NULL, bus_get_cb, self);
+        return;
+    }
+
+    context_create_auth_service (self, connection);
+    g_object_unref (connection);
+}
+
+void
+sso_auth_service_get_instance_async (SignonContext *self,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data)
+{
+    SignonContextPrivate *priv;
+    SsoAuthService *sso_auth_service;
+    GDBusConnection *connection;
+    GTask *task;
+
+    g_return_if_fail (SIGNON_IS_CONTEXT (self));
+    priv = self->priv;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    sso_auth_service = g_weak_ref_get (&priv->auth_service_ref);
+    if (sso_auth_service != NULL)
+    {
+        g_task_return_pointer (task, sso_auth_service, g_object_unref);
+        g_object_unref (task);
+        return;
+    }
+
+    g_mutex_lock (&priv->mutex);
+    priv->pending_tasks = g_slist_prepend (priv->pending_tasks, task);
+    if (priv->pending)
+    {
+        g_mutex_unlock (&priv->mutex);
+        return;
+    }
+
+    /* Create the object; any other request made before this completes will
+     * wait for the same proxy. */
+    priv->pending = TRUE;
+    /* The connection is dropped under the lock when it gets closed, possibly
+     * from another thread */
+    connection = priv->connection != NULL ?
+        g_object_ref (priv->connection) : NULL;
+    g_mutex_unlock (&priv->mutex);
+
+    if (connection != NULL)
+    {
+        context_create_auth_service (g_object_ref (self), connection);
+        g_object_unref (connection);
+    }
+    else if (priv->address != NULL)
+        g_dbus_connection_new_for_address (priv->address,
+                                           G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                           NULL,
+                                           NULL,
+                                           address_connect_cb,
+                                           g_object_ref (self));
+    else
+        g_bus_get (G_BUS_TYPE_SESSION, NULL, bus_get_cb, g_object_ref (self));
+}
+
+SsoAuthService *
+sso_auth_service_get_instance_finish (GAsyncResult *res, GError **error)
+{
+    g_return_val_if_fail (G_IS_TASK (res), NULL);
+
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static QueryCacheEntry *
+context_query_cache_lookup (SignonContext *self, const gchar *method)
+{
+    SignonContextPrivate *priv = self->priv;
+    QueryCacheEntry *entry;
+
+    if (method == NULL)
+        return &priv->methods_cache;
+
+    entry = g_hash_table_lookup (priv->mechanisms_cache, method);
+    if (entry == NULL)
+    {
+        entry = g_slice_new0 (QueryCacheEntry);
+        g_hash_table_insert (priv->mechanisms_cache, g_strdup (method), entry);
+    }
+    return entry;
+}
+
+static void
+query_data_free (QueryData *data)
+{
+    g_object_unref (data->context);
+    g_free (data->method);
+    g_slice_free (QueryData, data);
+}
+
+static void
+context_query_complete (QueryData *data, gchar **value, const GError *error)
+{
+    SignonContextPrivate *priv = data->context->priv;
+    QueryCacheEntry *entry;
+    GSList *waiters, *list;
+
+    entry = context_query_cache_lookup (data->context, data->method);
+
+    if (error == NULL &&
+        priv->query_cache_ttl > 0 &&
+        data->generation == priv->query_cache_generation)
+    {
+        g_strfreev (entry->value);
+        entry->value = g_strdupv (value);
+        entry->expiry = g_get_monotonic_time () +
+            (gint64)priv->query_cache_ttl * G_USEC_PER_SEC;
+    }
+
+    waiters = g_slist_reverse (entry->waiters);
+    entry->waiters = NULL;
+
+    for (list = waiters; list != NULL; list = list->next)
+    {
+        GTask *task = list->data;
+
+        if (error == NULL)
+            g_task_return_pointer (task, g_strdupv (value),
+                                   (GDestroyNotify) g_strfreev);
+        else
+            g_task_return_error (task, g_error_copy (error));
+        g_object_unref (task);
+    }
+    g_slist_free (waiters);
+
+    query_data_free (data);
+}
+
+static void
+context_query_reply_cb (GObject *object, GAsyncResult *res,
+                        gpointer user_data)
+{
+    SsoAuthService *proxy = SSO_AUTH_SERVICE (object);
+    QueryData *data = user_data;
+    gchar **value = NULL;
+    GError *error = NULL;
+
+    if (data->method == NULL)
+        sso_auth_service_call_query_methods_finish (proxy, &value,
+                                                    res, &error);
+    else
+        sso_auth_service_call_query_mechanisms_finish (proxy, &value,
+                                                       res, &error);
+
+    context_query_complete (data, value, error);
+
+    g_strfreev (value);
+    g_clear_error (&error);
+}
+
+static void
+context_query_proxy_cb (GObject *object, GAsyncResult *res,
+                        gpointer user_data)
+{
+    QueryData *data = user_data;
+    SsoAuthService *proxy;
+    GError *error = NULL;
+
+    proxy = sso_auth_service_get_instance_finish (res, &error);
+    if (G_UNLIKELY (error != NULL))
+    {
+        context_query_complete (data, NULL, error);
+        g_error_free (error);
+        return;
+    }
+
+    /* This call is shared by all the waiters: it's not cancellable */
+    if (data->method == NULL)
+        sso_auth_service_call_query_methods (proxy,
+                                             NULL,
+                                             context_query_reply_cb,
+                                             data);
+    else
+        sso_auth_service_call_query_mechanisms (proxy,
+                                                data->method,
+                                                NULL,
+                                                context_query_reply_cb,
+                                                data);
+    g_object_unref (proxy);
+}
+
+static void
+context_query_async (SignonContext *self,
+                     const gchar *method,
+                     GCancellable *cancellable,
+                     GAsyncReadyCallback callback,
+                     gpointer user_data)
+{
+    QueryCacheEntry *entry;
+    QueryData *data;
+    GTask *task;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    entry = context_query_cache_lookup (self, method);
+    if (entry->value != NULL && entry->expiry > g_get_monotonic_time ())
+    {
+        g_task_return_pointer (task, g_strdupv (entry->value),
+                               (GDestroyNotify) g_strfreev);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Coalesce with the identical request already in flight, if any */
+    entry->waiters = g_slist_prepend (entry->waiters, task);
+    if (entry->waiters->next != NULL) return;
+
+    data = g_slice_new (QueryData);
+    data->context = g_object_ref (self);
+    data->method = g_strdup (method);
+    data->generation = self->priv->query_cache_generation;
+    sso_auth_service_get_instance_async (self, NULL,
+                                         context_query_proxy_cb, data);
+}
+
+void
+signon_context_query_methods_async (SignonContext *self,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data)
+{
+    g_return_if_fail (SIGNON_IS_CONTEXT (self));
+
+    context_query_async (self, NULL, cancellable, callback, user_data);
+}
+
+gchar **
+signon_context_query_methods_finish (SignonContext *self,
+                                     GAsyncResult *res,
+                                     GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (res, self), NULL);
+
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+void
+signon_context_query_mechanisms_async (SignonContext *self,
+                                       const gchar *method,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data)
+{
+    g_return_if_fail (SIGNON_IS_CONTEXT (self));
+    g_return_if_fail (method != NULL);
+
+    context_query_async (self, method, cancellable, callback, user_data);
+}
+
+gchar **
+signon_context_query_mechanisms_finish (SignonContext *self,
+                                        GAsyncResult *res,
+                                        GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (res, self), NULL);
+
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+SignonIdentityInfoEntry *
+signon_context_ref_identity_info (SignonContext *self, guint32 id)
+{
+    SignonIdentityInfoEntry *entry;
+
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (self), NULL);
+    g_return_val_if_fail (id != 0, NULL);
+
+    entry = g_hash_table_lookup (self->priv->identity_info_cache,
+                                 GUINT_TO_POINTER (id));
+    if (entry == NULL)
+    {
+        entry = g_slice_new0 (SignonIdentityInfoEntry);
+        entry->id = id;
+        g_hash_table_insert (self->priv->identity_info_cache,
+                             GUINT_TO_POINTER (id), entry);
+    }
+    entry->ref_count++;
+    return entry;
+}
+
+void
+signon_context_unref_identity_info (SignonContext *self,
+                                    SignonIdentityInfoEntry *entry)
+{
+    g_return_if_fail (SIGNON_IS_CONTEXT (self));
+    g_return_if_fail (entry != NULL);
+
+    if (--entry->ref_count == 0)
+        g_hash_table_remove (self->priv->identity_info_cache,
+                             GUINT_TO_POINTER (entry->id));
+}
+
+SignonIdentity *
+signon_context_lookup_identity (SignonContext *self, guint32 id)
+{
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (self), NULL);
+
+    return g_hash_table_lookup (self->priv->interned_identities,
+                                GUINT_TO_POINTER (id));
+}
+
+void
+signon_context_intern_identity (SignonContext *self, guint32 id,
+                                SignonIdentity *identity)
+{
+    g_return_if_fail (SIGNON_IS_CONTEXT (self));
+    g_return_if_fail (id != 0);
+
+    g_hash_table_insert (self->priv->interned_identities,
+                         GUINT_TO_POINTER (id), identity);
+}
+
+void
+signon_context_unintern_identity (SignonContext *self, guint32 id,
+                                  SignonIdentity *identity)
+{
+    g_return_if_fail (SIGNON_IS_CONTEXT (self));
+
+    if (g_hash_table_lookup (self->priv->interned_identities,
+                             GUINT_TO_POINTER (id)) == identity)
+        g_hash_table_remove (self->priv->interned_identities,
+                             GUINT_TO_POINTER (id));
+}
+
+void
+signon_context_pool_auth_session (SignonContext *self,
+                                  guint32 id,
+                                  const gchar *method,
+                                  GDBusProxy *proxy)
+{
+    SignonContextPrivate *priv;
+    PooledSession *pooled;
+
+    g_return_if_fail (SIGNON_IS_CONTEXT (self));
+    g_return_if_fail (G_IS_DBUS_PROXY (proxy));
+    priv = self->priv;
+
+    if (priv->session_pool_size == 0)
+    {
+        g_object_unref (proxy);
+        return;
+    }
+
+    pooled = g_slice_new (PooledSession);
+    pooled->context = self;
+    pooled->proxy = proxy;
+    pooled->id = id;
+    pooled->method = g_strdup (method);
+    pooled->unregistered_id =
+        g_signal_connect (proxy, "unregistered",
+                          G_CALLBACK (pooled_session_unregistered_cb),
+                          pooled);
+    pooled->timeout_source =
+        g_timeout_source_new_seconds (priv->session_pool_idle_timeout);
+    g_source_set_callback (pooled->timeout_source, pooled_session_timeout_cb,
+                           pooled, NULL);
+    g_source_attach (pooled->timeout_source,
+                     g_main_context_get_thread_default ());
+
+    g_queue_push_head (&priv->session_pool, pooled);
+    context_session_pool_trim (self, priv->session_pool_size);
+}
+
+GDBusProxy *
+signon_context_take_auth_session (SignonContext *self,
+                                  guint32 id,
+                                  const gchar *method)
+{
+    PooledSession *pooled;
+    GDBusProxy *proxy;
+    GList *list;
+
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (self), NULL);
+
+    for (list = self->priv->session_pool.head; list != NULL; list = list->next)
+    {
+        pooled = list->data;
+        if (pooled->id == id && g_strcmp0 (pooled->method, method) == 0)
+            break;
+    }
+    if (list == NULL) return NULL;
+
+    g_queue_delete_link (&self->priv->session_pool, list);
+    proxy = g_object_ref (pooled->proxy);
+    pooled_session_free (pooled);
+    return proxy;
+}
+
+guint
+signon_context_get_token_cache_ttl (SignonContext *self)
+{
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (self), 0);
+
+    return self->priv->token_cache_ttl;
+}
+
+GVariant *
+signon_context_lookup_token (SignonContext *self, const gchar *key)
+{
+    TokenCacheEntry *entry;
+
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (self), NULL);
+
+    entry = g_hash_table_lookup (self->priv->token_cache, key);
+    if (entry == NULL) return NULL;
+
+    if (entry->expiry <= g_get_monotonic_time ())
+    {
+        g_hash_table_remove (self->priv->token_cache, key);
+        return NULL;
+    }
+
+    return g_variant_ref (entry->reply);
+}
+
+void
+signon_context_store_token (SignonContext *self, const gchar *key,
+                            guint32 id, GVariant *reply)
+{
+    SignonContextPrivate *priv;
+    TokenCacheEntry *entry;
+    GHashTableIter iter;
+    gint64 lifetime, expires_in, now;
+
+    g_return_if_fail (SIGNON_IS_CONTEXT (self));
+    priv = self->priv;
+
+    lifetime = priv->token_cache_ttl;
+    expires_in = signon_reply_get_expires_in (reply);
+    if (expires_in >= 0)
+        lifetime = MIN (lifetime, expires_in);
+    if (lifetime <= 0) return;
+
+    now = g_get_monotonic_time ();
+    if (g_hash_table_size (priv->token_cache) >= TOKEN_CACHE_PRUNE_THRESHOLD)
+    {
+        g_hash_table_iter_init (&iter, priv->token_cache);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry))
+        {
+            if (entry->expiry <= now)
+                g_hash_table_iter_remove (&iter);
+        }
+    }
+
+    entry = g_slice_new (TokenCacheEntry);
+    entry->reply = g_variant_ref (reply);
+    entry->expiry = now + lifetime * G_USEC_PER_SEC;
+    entry->id = id;
+    g_hash_table_replace (priv->token_cache, g_strdup (key), entry);
+}
+
+void
+signon_context_invalidate_tokens (SignonContext *self, guint32 id)
+{
+    GHashTableIter iter;
+    TokenCacheEntry *entry;
+
+    g_return_if_fail (SIGNON_IS_CONTEXT (self));
+
+    g_hash_table_iter_init (&iter, self->priv->token_cache);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry))
+    {
+        if (entry->id == id)
+            g_hash_table_iter_remove (&iter);
+    }
+}
+
+/* Returns TRUE if a call with the same key is in flight: @task will then be
+ * handed to the caller of signon_context_complete_process(). Otherwise, the
+ * caller becomes the owner of the call. */
+gboolean
+signon_context_join_process (SignonContext *self, const gchar *key,
+                             GTask *task)
+{
+    SignonContextPrivate *priv;
+    GQueue *waiters;
+
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (self), FALSE);
+    g_return_val_if_fail (key != NULL, FALSE);
+    priv = self->priv;
+
+    waiters = g_hash_table_lookup (priv->shared_processes, key);
+    if (waiters == NULL)
+    {
+        g_hash_table_insert (priv->shared_processes, g_strdup (key),
+                             g_queue_new ());
+        return FALSE;
+    }
+
+    g_queue_push_tail (waiters, g_object_ref (task));
+    return TRUE;
+}
+
+/* Removes @task from the requests waiting for the call @key; if it was
+ * there, returns TRUE and hands over the reference to the caller. */
+gboolean
+signon_context_leave_process (SignonContext *self, const gchar *key,
+                              GTask *task)
+{
+    GQueue *waiters;
+
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (self), FALSE);
+    g_return_val_if_fail (key != NULL, FALSE);
+
+    waiters = g_hash_table_lookup (self->priv->shared_processes, key);
+    return waiters != NULL && g_queue_remove (waiters, task);
+}
+
+/* Returns the GTasks (owned) waiting for the call, or NULL */
+GQueue *
+signon_context_complete_process (SignonContext *self, const gchar *key)
+{
+    GQueue *waiters = NULL;
+    gchar *stored_key;
+
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (self), NULL);
+    g_return_val_if_fail (key != NULL, NULL);
+
+    if (g_hash_table_lookup_extended (self->priv->shared_processes, key,
+                                      (gpointer *)&stored_key,
+                                      (gpointer *)&waiters))
+    {
+        g_hash_table_steal (self->priv->shared_processes, key);
+        g_free (stored_key);
+    }
+    return waiters;
+}
+
+void
+signon_context_adjust_queue_depth (SignonContext *self,
+                                   SignonPriority priority, gint delta)
+{
+    g_return_if_fail (SIGNON_IS_CONTEXT (self));
+
+    self->priv->queue_depth[SIGNON_PRIORITY_LANE (priority)] += delta;
+}
+
+/* Returns TRUE if @session can send a request right away; otherwise
+ * signon_auth_session_process_next() will be called once a slot is free. */
+gboolean
+signon_context_acquire_process_slot (SignonContext *self,
+                                     SignonAuthSession *session,
+                                     SignonPriority priority)
+{
+    SignonContextPrivate *priv;
+    guint lane = SIGNON_PRIORITY_LANE (priority);
+
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (self), FALSE);
+    priv = self->priv;
+
+    if (context_lane_can_run (self, lane))
+    {
+        priv->in_flight[lane]++;
+        return TRUE;
+    }
+
+    if (g_queue_find (&priv->slot_waiters[lane], session) == NULL)
+        g_queue_push_tail (&priv->slot_waiters[lane], g_object_ref (session));
+    return FALSE;
+}
+
+void
+signon_context_release_process_slot (SignonContext *self,
+                                     SignonPriority priority)
+{
+    guint lane = SIGNON_PRIORITY_LANE (priority);
+
+    g_return_if_fail (SIGNON_IS_CONTEXT (self));
+    g_return_if_fail (self->priv->in_flight[lane] > 0);
+
+    self->priv->in_flight[lane]--;
+    context_run_slot_waiters (self);
+}
@@ -0,0 +1,76 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This file is part of libsignon-glib
+ *
+ * Copyright (C) 2018 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef _SIGNON_CONTEXT_H_
+#define _SIGNON_CONTEXT_H_
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define SIGNON_TYPE_CONTEXT             (signon_context_get_type ())
+#define SIGNON_CONTEXT(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), SIGNON_TYPE_CONTEXT, SignonContext))
+#define SIGNON_CONTEXT_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), SIGNON_TYPE_CONTEXT, SignonContextClass))
+#define SIGNON_IS_CONTEXT(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SIGNON_TYPE_CONTEXT))
+#define SIGNON_IS_CONTEXT_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), SIGNON_TYPE_CONTEXT))
+#define SIGNON_CONTEXT_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), SIGNON_TYPE_CONTEXT, SignonContextClass))
+
+typedef struct _SignonContextClass SignonContextClass;
+typedef struct _SignonContextPrivate SignonContextPrivate;
+typedef struct _SignonContext SignonContext;
+
+/**
+ * SignonContextClass:
+ *
+ * Opaque struct. Use the accessor functions below.
+ */
+struct _SignonContextClass
+{
+    GObjectClass parent_class;
+};
+
+/**
+ * SignonContext:
+ *
+ * Opaque struct. Use the accessor functions below.
+ */
+struct _SignonContext
+{
+    GObject parent_instance;
+    SignonContextPrivate *priv;
+};
+
+GType signon_context_get_type (void) G_GNUC_CONST;
+
+SignonContext *signon_context_new (GDBusConnection *connection);
+SignonContext *signon_context_new_for_address (const gchar *address);
+SignonContext *signon_context_get_default ();
+
+GDBusConnection *signon_context_get_connection (SignonContext *self);
+
+guint signon_context_get_queue_depth (SignonContext *self);
+
+G_END_DECLS
+
+#endif /* _SIGNON_CONTEXT_H_ */
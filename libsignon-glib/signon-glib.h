@@ -27,9 +27,11 @@
 
 #include <libsignon-glib/signon-auth-service.h>
 #include <libsignon-glib/signon-auth-session.h>
+#include <libsignon-glib/signon-context.h>
 #include <libsignon-glib/signon-enum-types.h>
 #include <libsignon-glib/signon-errors.h>
 #include <libsignon-glib/signon-identity-info.h>
 #include <libsignon-glib/signon-identity.h>
+#include <libsignon-glib/signon-token-refresher.h>
 
 #endif /* SIGNON_GLIB_H */
@@ -36,10 +36,25 @@
 #include "signon-internals.h"
 #include "signon-utils.h"
 
+#include <string.h>
+
 G_DEFINE_BOXED_TYPE (SignonIdentityInfo, signon_identity_info,
                      (GBoxedCopyFunc)signon_identity_info_copy,
                      (GBoxedFreeFunc)signon_identity_info_free);
 
+struct _SignonIdentityInfoIter
+{
+    volatile gint ref_count;
+    /* The aa{sv} list, as received from signond */
+    GVariant *list;
+    gsize n_items;
+    gsize next;
+};
+
+G_DEFINE_BOXED_TYPE (SignonIdentityInfoIter, signon_identity_info_iter,
+                     (GBoxedCopyFunc)signon_identity_info_iter_ref,
+                     (GBoxedFreeFunc)signon_identity_info_iter_unref);
+
 
 static GVariant *
 signon_variant_new_string (const gchar *string)
@@ -47,19 +62,170 @@ signon_variant_new_string (const gchar *string)
     return g_variant_new_string (string != NULL ? string : "");
 }
 
-static const gchar *identity_info_get_secret (const SignonIdentityInfo *info)
+static const gchar *
+identity_info_get_string (const gchar *value, GVariant *variant)
 {
-    g_return_val_if_fail (info != NULL, NULL);
+    if (value != NULL || variant == NULL)
+        return value;
+    return g_variant_get_string (variant, NULL);
+}
+
+/* The getters decode the values on first access, and the data they work on
+ * can be shared by copies living in different threads: the decoding is
+ * serialized by this mutex, and the variant pointer is cleared only once the
+ * decoded value is in place. */
+static GMutex decode_mutex;
+
+static void
+identity_info_decode_methods (SignonIdentityInfoData *data)
+{
+    GVariantIter iter;
+    GVariant *variant;
+    gchar *method;
+    gchar **mechanisms;
 
-    return info->secret;
+    if (g_atomic_pointer_get (&data->methods_variant) == NULL)
+        return;
+
+    g_mutex_lock (&decode_mutex);
+    variant = data->methods_variant;
+    if (variant != NULL)
+    {
+        g_variant_iter_init (&iter, variant);
+        while (g_variant_iter_next (&iter, "{s^as}", &method, &mechanisms))
+        {
+            g_hash_table_insert (data->methods, method, mechanisms);
+        }
+        g_atomic_pointer_set (&data->methods_variant, NULL);
+        g_variant_unref (variant);
+    }
+    g_mutex_unlock (&decode_mutex);
 }
 
-static void identity_info_set_id (SignonIdentityInfo *info, gint id)
+static void
+identity_info_decode_strv (gchar ***field, GVariant **variant)
 {
-    g_return_if_fail (info != NULL);
-    g_return_if_fail (id >= 0);
+    GVariant *value;
+
+    if (g_atomic_pointer_get (variant) == NULL)
+        return;
+
+    g_mutex_lock (&decode_mutex);
+    value = *variant;
+    if (value != NULL)
+    {
+        *field = g_variant_dup_strv (value, NULL);
+        g_atomic_pointer_set (variant, NULL);
+        g_variant_unref (value);
+    }
+    g_mutex_unlock (&decode_mutex);
+}
+
+static void
+identity_info_decode_all (SignonIdentityInfoData *data)
+{
+    identity_info_decode_methods (data);
+    identity_info_decode_strv (&data->realms, &data->realms_variant);
+    identity_info_decode_strv (&data->access_control_list,
+                               &data->acl_variant);
+}
+
+static SignonIdentityInfoData *
+identity_info_data_new ()
+{
+    SignonIdentityInfoData *data = g_slice_new0 (SignonIdentityInfoData);
+
+    data->ref_count = 1;
+    data->methods = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, (GDestroyNotify)g_strfreev);
+    data->store_secret = FALSE;
+    return data;
+}
+
+static void
+identity_info_data_unref (SignonIdentityInfoData *data)
+{
+    if (!g_atomic_int_dec_and_test (&data->ref_count))
+        return;
+
+    g_free (data->username);
+    g_free (data->secret);
+    g_free (data->caption);
+
+    g_hash_table_destroy (data->methods);
+
+    g_strfreev (data->realms);
+    g_strfreev (data->access_control_list);
+
+    g_clear_pointer (&data->username_variant, g_variant_unref);
+    g_clear_pointer (&data->secret_variant, g_variant_unref);
+    g_clear_pointer (&data->caption_variant, g_variant_unref);
+    g_clear_pointer (&data->methods_variant, g_variant_unref);
+    g_clear_pointer (&data->realms_variant, g_variant_unref);
+    g_clear_pointer (&data->acl_variant, g_variant_unref);
+    g_clear_pointer (&data->serialized, g_variant_unref);
+
+    g_slice_free (SignonIdentityInfoData, data);
+}
+
+static GVariant *
+variant_ref0 (GVariant *variant)
+{
+    return variant != NULL ? g_variant_ref (variant) : NULL;
+}
+
+/* Gives @info its own copy of the data, if it's shared with other copies;
+ * to be called before any modification, as it also drops the serialized
+ * form which is about to become outdated. */
+static SignonIdentityInfoData *
+identity_info_make_writable (SignonIdentityInfo *info)
+{
+    SignonIdentityInfoData *data = info->data;
+    SignonIdentityInfoData *copy;
+    GHashTableIter iter;
+    gpointer method, mechanisms;
+
+    if (g_atomic_int_get (&data->ref_count) == 1)
+    {
+        g_clear_pointer (&data->serialized, g_variant_unref);
+        return data;
+    }
+
+    /* Other copies might be decoding the data right now */
+    identity_info_decode_all (data);
+
+    copy = identity_info_data_new ();
+    copy->id = data->id;
+    copy->username = g_strdup (data->username);
+    copy->secret = g_strdup (data->secret);
+    copy->caption = g_strdup (data->caption);
+    copy->store_secret = data->store_secret;
+    g_hash_table_iter_init (&iter, data->methods);
+    while (g_hash_table_iter_next (&iter, &method, &mechanisms))
+    {
+        g_hash_table_insert (copy->methods, g_strdup (method),
+                             g_strdupv (mechanisms));
+    }
+    copy->realms = g_strdupv (data->realms);
+    copy->access_control_list = g_strdupv (data->access_control_list);
+    copy->type = data->type;
+
+    /* The strings are never decoded in place: share their variants */
+    copy->username_variant = variant_ref0 (data->username_variant);
+    copy->secret_variant = variant_ref0 (data->secret_variant);
+    copy->caption_variant = variant_ref0 (data->caption_variant);
+
+    identity_info_data_unref (data);
+    info->data = copy;
+    return copy;
+}
+
+static const gchar *identity_info_get_secret (const SignonIdentityInfo *info)
+{
+    g_return_val_if_fail (info != NULL, NULL);
 
-    info->id = id;
+    return identity_info_get_string (info->data->secret,
+                                     info->data->secret_variant);
 }
 
 static void identity_methods_copy (gpointer key, gpointer value, gpointer user_data)
@@ -77,91 +243,106 @@ void signon_identity_info_set_methods (SignonIdentityInfo *info,
 
     DEBUG("%s", G_STRFUNC);
 
-    if (info->methods)
-        g_hash_table_remove_all (info->methods);
-    else
-        info->methods = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                               g_free, (GDestroyNotify)g_strfreev);
+    SignonIdentityInfoData *data = identity_info_make_writable (info);
+
+    g_clear_pointer (&data->methods_variant, g_variant_unref);
+    g_hash_table_remove_all (data->methods);
 
     g_hash_table_foreach ((GHashTable *)methods, identity_methods_copy, info);
 }
 
+/* Scans the dictionary only once: the scalars are decoded right away, while
+ * the other values are kept and decoded on first access. */
 SignonIdentityInfo *
 signon_identity_info_new_from_variant (GVariant *variant)
 {
-    GVariant *method_map;
+    GVariantIter iter;
+    const gchar *key;
+    GVariant *value;
+    gboolean has_store_secret = FALSE;
+    gboolean store_secret = FALSE;
 
     if (!variant)
         return NULL;
 
     SignonIdentityInfo *info = signon_identity_info_new ();
+    SignonIdentityInfoData *data = info->data;
 
     DEBUG("%s: ", G_STRFUNC);
 
-    g_variant_lookup (variant,
-                      SIGNOND_IDENTITY_INFO_ID,
-                      "u",
-                      &info->id);
-
-    g_variant_lookup (variant,
-                      SIGNOND_IDENTITY_INFO_USERNAME,
-                      "s",
-                      &info->username);
-
-    if (g_variant_lookup (variant,
-                          SIGNOND_IDENTITY_INFO_SECRET,
-                          "s",
-                          &info->secret))
+    g_variant_iter_init (&iter, variant);
+    while (g_variant_iter_next (&iter, "{&sv}", &key, &value))
     {
-        g_variant_lookup (variant,
-                          SIGNOND_IDENTITY_INFO_STORESECRET,
-                          "b",
-                          &info->store_secret);
-    }
+        GVariant **target = NULL;
 
-    g_variant_lookup (variant,
-                      SIGNOND_IDENTITY_INFO_CAPTION,
-                      "s",
-                      &info->caption);
-
-    g_variant_lookup (variant,
-                      SIGNOND_IDENTITY_INFO_REALMS,
-                      "^as",
-                      &info->realms);
-
-    /* get the methods */
-    if (g_variant_lookup (variant,
-                          SIGNOND_IDENTITY_INFO_AUTHMETHODS,
-                          "@a{sas}",
-                          &method_map))
-    {
-        GVariantIter iter;
-        gchar *method;
-        gchar **mechanisms;
+        if (strcmp (key, SIGNOND_IDENTITY_INFO_ID) == 0)
+        {
+            if (g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32))
+                data->id = g_variant_get_uint32 (value);
+        }
+        else if (strcmp (key, SIGNOND_IDENTITY_INFO_TYPE) == 0)
+        {
+            if (g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32))
+                data->type = g_variant_get_uint32 (value);
+        }
+        else if (strcmp (key, SIGNOND_IDENTITY_INFO_STORESECRET) == 0)
+        {
+            if (g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+            {
+                store_secret = g_variant_get_boolean (value);
+                has_store_secret = TRUE;
+            }
+        }
+        else if (strcmp (key, SIGNOND_IDENTITY_INFO_USERNAME) == 0)
+        {
+            if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+                target = &data->username_variant;
+        }
+        else if (strcmp (key, SIGNOND_IDENTITY_INFO_SECRET) == 0)
+        {
+            if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+                target = &data->secret_variant;
+        }
+        else if (strcmp (key, SIGNOND_IDENTITY_INFO_CAPTION) == 0)
+        {
+            if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+                target = &data->caption_variant;
+        }
+        else if (strcmp (key, SIGNOND_IDENTITY_INFO_AUTHMETHODS) == 0)
+        {
+            if (g_variant_is_of_type (value, G_VARIANT_TYPE ("a{sas}")))
+                target = &data->methods_variant;
+        }
+        else if (strcmp (key, SIGNOND_IDENTITY_INFO_REALMS) == 0)
+        {
+            if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING_ARRAY))
+                target = &data->realms_variant;
+        }
+        else if (strcmp (key, SIGNOND_IDENTITY_INFO_ACL) == 0)
+        {
+            if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING_ARRAY))
+                target = &data->acl_variant;
+        }
 
-        g_variant_iter_init (&iter, method_map);
-        while (g_variant_iter_next (&iter, "{s^as}", &method, &mechanisms))
+        if (target != NULL)
         {
-            g_hash_table_insert (info->methods, method, mechanisms);
+            if (*target != NULL)
+                g_variant_unref (*target);
+            *target = value;
         }
-        g_variant_unref (method_map);
+        else
+            g_variant_unref (value);
     }
 
-    g_variant_lookup (variant,
-                      SIGNOND_IDENTITY_INFO_ACL,
-                      "^as",
-                      &info->access_control_list);
-
-    g_variant_lookup (variant,
-                      SIGNOND_IDENTITY_INFO_TYPE,
-                      "u",
-                      &info->type);
+    /* The storing flag is only meaningful if the secret was given */
+    if (data->secret_variant != NULL && has_store_secret)
+        data->store_secret = store_secret;
 
     return info;
 }
 
-GVariant *
-signon_identity_info_to_variant (const SignonIdentityInfo *self)
+static GVariant *
+identity_info_build_variant (const SignonIdentityInfo *self)
 {
     GVariantBuilder builder;
     GVariantBuilder method_builder;
@@ -169,32 +350,38 @@ signon_identity_info_to_variant (const SignonIdentityInfo *self)
     GHashTableIter iter;
     const gchar *method;
     const gchar **mechanisms;
+    const gchar * const *realms;
+    const gchar * const *access_control_list;
 
     g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
 
     g_variant_builder_add (&builder, "{sv}",
                            SIGNOND_IDENTITY_INFO_ID,
-                           g_variant_new_uint32 (self->id));
+                           g_variant_new_uint32 (self->data->id));
 
     g_variant_builder_add (&builder, "{sv}",
                            SIGNOND_IDENTITY_INFO_USERNAME,
-                           signon_variant_new_string (self->username));
+                           signon_variant_new_string (
+                               signon_identity_info_get_username (self)));
 
     g_variant_builder_add (&builder, "{sv}",
                            SIGNOND_IDENTITY_INFO_SECRET,
-                           signon_variant_new_string (self->secret));
+                           signon_variant_new_string (
+                               identity_info_get_secret (self)));
 
     g_variant_builder_add (&builder, "{sv}",
                            SIGNOND_IDENTITY_INFO_CAPTION,
-                           signon_variant_new_string (self->caption));
+                           signon_variant_new_string (
+                               signon_identity_info_get_caption (self)));
 
     g_variant_builder_add (&builder, "{sv}",
                            SIGNOND_IDENTITY_INFO_STORESECRET,
-                           g_variant_new_boolean (self->store_secret));
+                           g_variant_new_boolean (self->data->store_secret));
 
     g_variant_builder_init (&method_builder,
                             (const GVariantType *)"a{sas}");
-    g_hash_table_iter_init (&iter, self->methods);
+    g_hash_table_iter_init (&iter,
+                            (GHashTable *)signon_identity_info_get_methods (self));
     while (g_hash_table_iter_next (&iter,
                                    (gpointer)&method,
                                    (gpointer)&mechanisms))
@@ -209,31 +396,71 @@ signon_identity_info_to_variant (const SignonIdentityInfo *self)
                            SIGNOND_IDENTITY_INFO_AUTHMETHODS,
                            method_map);
 
-    if (self->realms != NULL)
+    realms = signon_identity_info_get_realms (self);
+    if (realms != NULL)
     {
         g_variant_builder_add (&builder, "{sv}",
                                SIGNOND_IDENTITY_INFO_REALMS,
-                               g_variant_new_strv ((const gchar * const *)
-                                                   self->realms,
-                                                   -1));
+                               g_variant_new_strv (realms, -1));
     }
 
-    if (self->access_control_list != NULL)
+    access_control_list =
+        signon_identity_info_get_access_control_list (self);
+    if (access_control_list != NULL)
     {
         g_variant_builder_add (&builder, "{sv}",
                                SIGNOND_IDENTITY_INFO_ACL,
-                               g_variant_new_strv ((const gchar * const *)
-                                                   self->access_control_list,
-                                                   -1));
+                               g_variant_new_strv (access_control_list, -1));
     }
 
     g_variant_builder_add (&builder, "{sv}",
                            SIGNOND_IDENTITY_INFO_TYPE,
-                           g_variant_new_int32 (self->type));
+                           g_variant_new_int32 (self->data->type));
 
     return g_variant_builder_end (&builder);
 }
 
+/* Returns a new (non floating) reference to the serialized form of @self,
+ * which is built only once for as long as @self is not modified; copies
+ * of @self share it too. */
+GVariant *
+signon_identity_info_to_variant (const SignonIdentityInfo *self)
+{
+    SignonIdentityInfoData *data = self->data;
+    GVariant *variant;
+
+    variant = g_atomic_pointer_get (&data->serialized);
+    if (variant != NULL)
+        return g_variant_ref (variant);
+
+    /* Copies in other threads might be doing the same: keep the first */
+    variant = g_variant_ref_sink (
+        identity_info_build_variant (self));
+    if (!g_atomic_pointer_compare_and_exchange (&data->serialized,
+                                                NULL, variant))
+    {
+        g_variant_unref (variant);
+        variant = g_atomic_pointer_get (&data->serialized);
+    }
+
+    return g_variant_ref (variant);
+}
+
+/* Returns the info as signond has it once @info has been stored as the
+ * identity @id: up to date, and without the secret, which signond never
+ * gives back. */
+SignonIdentityInfo *
+signon_identity_info_new_stored (const SignonIdentityInfo *info, guint32 id)
+{
+    SignonIdentityInfo *stored = signon_identity_info_copy (info);
+    SignonIdentityInfoData *data = identity_info_make_writable (stored);
+
+    data->id = id;
+    g_clear_pointer (&data->secret, g_free);
+    g_clear_pointer (&data->secret_variant, g_variant_unref);
+    return stored;
+}
+
 /*
  * Public methods:
  */
@@ -248,9 +475,7 @@ signon_identity_info_to_variant (const SignonIdentityInfo *self)
 SignonIdentityInfo *signon_identity_info_new ()
 {
     SignonIdentityInfo *info = g_slice_new0 (SignonIdentityInfo);
-    info->methods = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                            g_free, (GDestroyNotify)g_strfreev);
-    info->store_secret = FALSE;
+    info->data = identity_info_data_new ();
 
     return info;
 }
@@ -265,15 +490,7 @@ void signon_identity_info_free (SignonIdentityInfo *info)
 {
     if (info == NULL) return;
 
-    g_free (info->username);
-    g_free (info->secret);
-    g_free (info->caption);
-
-    g_hash_table_destroy (info->methods);
-
-    g_strfreev (info->realms);
-    g_strfreev (info->access_control_list);
-
+    identity_info_data_unref (info->data);
     g_slice_free (SignonIdentityInfo, info);
 }
 
@@ -281,33 +498,18 @@ void signon_identity_info_free (SignonIdentityInfo *info)
  * signon_identity_info_copy:
  * @other: the #SignonIdentityInfo.
  *
- * Get a newly-allocated copy of @info.
+ * Get a newly-allocated copy of @info. The copy shares its data with @other
+ * until either of them is modified, so this is a cheap operation.
  *
  * Returns: a copy of the given #SignonIdentityInfo, or %NULL on failure.
  */
 SignonIdentityInfo *signon_identity_info_copy (const SignonIdentityInfo *other)
 {
     g_return_val_if_fail (other != NULL, NULL);
-    SignonIdentityInfo *info = signon_identity_info_new ();
-
-    identity_info_set_id (info, signon_identity_info_get_id (other));
-
-    signon_identity_info_set_username (info, signon_identity_info_get_username (other));
-
-    signon_identity_info_set_secret (info, identity_info_get_secret(other),
-                                     signon_identity_info_get_storing_secret (other));
-
-    signon_identity_info_set_caption (info, signon_identity_info_get_caption(other));
-
-    signon_identity_info_set_methods (info, signon_identity_info_get_methods (other));
-
-    signon_identity_info_set_realms (info, signon_identity_info_get_realms (other));
-
-    signon_identity_info_set_access_control_list (info,
-        signon_identity_info_get_access_control_list (other));
+    SignonIdentityInfo *info = g_slice_new (SignonIdentityInfo);
 
-    signon_identity_info_set_identity_type (info,
-        signon_identity_info_get_identity_type (other));
+    g_atomic_int_inc (&other->data->ref_count);
+    info->data = other->data;
 
     return info;
 }
@@ -323,7 +525,7 @@ SignonIdentityInfo *signon_identity_info_copy (const SignonIdentityInfo *other)
 gint signon_identity_info_get_id (const SignonIdentityInfo *info)
 {
     g_return_val_if_fail (info != NULL, -1);
-    return info->id;
+    return info->data->id;
 }
 
 /**
@@ -337,7 +539,8 @@ gint signon_identity_info_get_id (const SignonIdentityInfo *info)
 const gchar *signon_identity_info_get_username (const SignonIdentityInfo *info)
 {
     g_return_val_if_fail (info != NULL, NULL);
-    return info->username;
+    return identity_info_get_string (info->data->username,
+                                     info->data->username_variant);
 }
 
 /**
@@ -351,7 +554,7 @@ const gchar *signon_identity_info_get_username (const SignonIdentityInfo *info)
 gboolean signon_identity_info_get_storing_secret (const SignonIdentityInfo *info)
 {
     g_return_val_if_fail (info != NULL, FALSE);
-    return info->store_secret;
+    return info->data->store_secret;
 }
 
 /**
@@ -365,7 +568,8 @@ gboolean signon_identity_info_get_storing_secret (const SignonIdentityInfo *info
 const gchar *signon_identity_info_get_caption (const SignonIdentityInfo *info)
 {
     g_return_val_if_fail (info != NULL, NULL);
-    return info->caption;
+    return identity_info_get_string (info->data->caption,
+                                     info->data->caption_variant);
 }
 
 /**
@@ -380,7 +584,8 @@ const gchar *signon_identity_info_get_caption (const SignonIdentityInfo *info)
 const GHashTable *signon_identity_info_get_methods (const SignonIdentityInfo *info)
 {
     g_return_val_if_fail (info != NULL, NULL);
-    return info->methods;
+    identity_info_decode_methods (info->data);
+    return info->data->methods;
 }
 
 /**
@@ -394,7 +599,9 @@ const GHashTable *signon_identity_info_get_methods (const SignonIdentityInfo *in
 const gchar* const *signon_identity_info_get_realms (const SignonIdentityInfo *info)
 {
     g_return_val_if_fail (info != NULL, NULL);
-    return (const gchar* const *)info->realms;
+    identity_info_decode_strv (&info->data->realms,
+                               &info->data->realms_variant);
+    return (const gchar* const *)info->data->realms;
 }
 
 /**
@@ -408,7 +615,9 @@ const gchar* const *signon_identity_info_get_realms (const SignonIdentityInfo *i
 const gchar* const *signon_identity_info_get_access_control_list (const SignonIdentityInfo *info)
 {
     g_return_val_if_fail (info != NULL, NULL);
-    return (const gchar* const *)info->access_control_list;
+    identity_info_decode_strv (&info->data->access_control_list,
+                               &info->data->acl_variant);
+    return (const gchar* const *)info->data->access_control_list;
 }
 
 /**
@@ -422,7 +631,7 @@ const gchar* const *signon_identity_info_get_access_control_list (const SignonId
 SignonIdentityType signon_identity_info_get_identity_type (const SignonIdentityInfo *info)
 {
     g_return_val_if_fail (info != NULL, -1);
-    return (SignonIdentityType)info->type;
+    return (SignonIdentityType)info->data->type;
 }
 
 /**
@@ -435,10 +644,12 @@ SignonIdentityType signon_identity_info_get_identity_type (const SignonIdentityI
 void signon_identity_info_set_username (SignonIdentityInfo *info, const gchar *username)
 {
     g_return_if_fail (info != NULL);
+    SignonIdentityInfoData *data = identity_info_make_writable (info);
 
-    if (info->username) g_free (info->username);
+    if (data->username) g_free (data->username);
+    g_clear_pointer (&data->username_variant, g_variant_unref);
 
-    info->username = g_strdup (username);
+    data->username = g_strdup (username);
 }
 
 /**
@@ -454,11 +665,13 @@ void signon_identity_info_set_secret (SignonIdentityInfo *info, const gchar *sec
                                       gboolean store_secret)
 {
     g_return_if_fail (info != NULL);
+    SignonIdentityInfoData *data = identity_info_make_writable (info);
 
-    if (info->secret) g_free (info->secret);
+    if (data->secret) g_free (data->secret);
+    g_clear_pointer (&data->secret_variant, g_variant_unref);
 
-    info->secret = g_strdup (secret);
-    info->store_secret = store_secret;
+    data->secret = g_strdup (secret);
+    data->store_secret = store_secret;
 }
 
 /**
@@ -471,10 +684,12 @@ void signon_identity_info_set_secret (SignonIdentityInfo *info, const gchar *sec
 void signon_identity_info_set_caption (SignonIdentityInfo *info, const gchar *caption)
 {
     g_return_if_fail (info != NULL);
+    SignonIdentityInfoData *data = identity_info_make_writable (info);
 
-    if (info->caption) g_free (info->caption);
+    if (data->caption) g_free (data->caption);
+    g_clear_pointer (&data->caption_variant, g_variant_unref);
 
-    info->caption = g_strdup (caption);
+    data->caption = g_strdup (caption);
 }
 
 /**
@@ -491,12 +706,13 @@ void signon_identity_info_set_method (SignonIdentityInfo *info, const gchar *met
                                       const gchar* const *mechanisms)
 {
     g_return_if_fail (info != NULL);
-
-    g_return_if_fail (info->methods != NULL);
     g_return_if_fail (method != NULL);
     g_return_if_fail (mechanisms != NULL);
+    SignonIdentityInfoData *data = identity_info_make_writable (info);
+
+    identity_info_decode_methods (data);
 
-    g_hash_table_replace (info->methods,
+    g_hash_table_replace (data->methods,
                           g_strdup(method), g_strdupv((gchar **)mechanisms));
 }
 
@@ -511,9 +727,10 @@ void signon_identity_info_set_method (SignonIdentityInfo *info, const gchar *met
 void signon_identity_info_remove_method (SignonIdentityInfo *info, const gchar *method)
 {
     g_return_if_fail (info != NULL);
-    g_return_if_fail (info->methods != NULL);
+    SignonIdentityInfoData *data = identity_info_make_writable (info);
 
-    g_hash_table_remove (info->methods, method);
+    identity_info_decode_methods (data);
+    g_hash_table_remove (data->methods, method);
 }
 
 /**
@@ -527,10 +744,12 @@ void signon_identity_info_set_realms (SignonIdentityInfo *info,
                                       const gchar* const *realms)
 {
     g_return_if_fail (info != NULL);
+    SignonIdentityInfoData *data = identity_info_make_writable (info);
 
-    if (info->realms) g_strfreev (info->realms);
+    if (data->realms) g_strfreev (data->realms);
+    g_clear_pointer (&data->realms_variant, g_variant_unref);
 
-    info->realms = g_strdupv ((gchar **)realms);
+    data->realms = g_strdupv ((gchar **)realms);
 }
 
 /**
@@ -546,10 +765,12 @@ void signon_identity_info_set_access_control_list (SignonIdentityInfo *info,
                                                    const gchar* const *access_control_list)
 {
     g_return_if_fail (info != NULL);
+    SignonIdentityInfoData *data = identity_info_make_writable (info);
 
-    if (info->access_control_list) g_strfreev (info->access_control_list);
+    if (data->access_control_list) g_strfreev (data->access_control_list);
+    g_clear_pointer (&data->acl_variant, g_variant_unref);
 
-    info->access_control_list = g_strdupv ((gchar **)access_control_list);
+    data->access_control_list = g_strdupv ((gchar **)access_control_list);
 }
 
 /**
@@ -563,5 +784,112 @@ void signon_identity_info_set_identity_type (SignonIdentityInfo *info,
                                              SignonIdentityType type)
 {
     g_return_if_fail (info != NULL);
-    info->type = (gint)type;
+    SignonIdentityInfoData *data = identity_info_make_writable (info);
+
+    data->type = (gint)type;
+}
+
+SignonIdentityInfoIter *
+signon_identity_info_iter_new (GVariant *list)
+{
+    SignonIdentityInfoIter *iter;
+
+    g_return_val_if_fail (g_variant_is_of_type (list,
+                                                G_VARIANT_TYPE ("aa{sv}")),
+                          NULL);
+
+    iter = g_slice_new (SignonIdentityInfoIter);
+    iter->ref_count = 1;
+    iter->list = g_variant_ref_sink (list);
+    iter->n_items = g_variant_n_children (list);
+    iter->next = 0;
+    return iter;
+}
+
+/**
+ * signon_identity_info_iter_ref:
+ * @iter: the #SignonIdentityInfoIter.
+ *
+ * Adds a reference to @iter.
+ *
+ * Returns: (transfer full): @iter.
+ *
+ * Since: 1.15
+ */
+SignonIdentityInfoIter *
+signon_identity_info_iter_ref (SignonIdentityInfoIter *iter)
+{
+    g_return_val_if_fail (iter != NULL, NULL);
+
+    g_atomic_int_inc (&iter->ref_count);
+    return iter;
+}
+
+/**
+ * signon_identity_info_iter_unref:
+ * @iter: the #SignonIdentityInfoIter.
+ *
+ * Removes a reference from @iter, destroying it if this was the last one.
+ *
+ * Since: 1.15
+ */
+void
+signon_identity_info_iter_unref (SignonIdentityInfoIter *iter)
+{
+    g_return_if_fail (iter != NULL);
+
+    if (g_atomic_int_dec_and_test (&iter->ref_count))
+    {
+        g_variant_unref (iter->list);
+        g_slice_free (SignonIdentityInfoIter, iter);
+    }
+}
+
+/**
+ * signon_identity_info_iter_get_n_items:
+ * @iter: the #SignonIdentityInfoIter.
+ *
+ * Get the total number of identities in @iter, including those which have
+ * already been returned by signon_identity_info_iter_next().
+ *
+ * Returns: the number of items in @iter.
+ *
+ * Since: 1.15
+ */
+guint
+signon_identity_info_iter_get_n_items (SignonIdentityInfoIter *iter)
+{
+    g_return_val_if_fail (iter != NULL, 0);
+
+    return iter->n_items;
+}
+
+/**
+ * signon_identity_info_iter_next:
+ * @iter: the #SignonIdentityInfoIter.
+ *
+ * Get the next identity from @iter. The #SignonIdentityInfo is only built at
+ * this time, so that a long list of identities can be consumed a few items at
+ * a time without ever decoding all of them at once.
+ *
+ * Returns: (transfer full): the next #SignonIdentityInfo, which must be freed
+ * with signon_identity_info_free(), or %NULL if there are no more items.
+ *
+ * Since: 1.15
+ */
+SignonIdentityInfo *
+signon_identity_info_iter_next (SignonIdentityInfoIter *iter)
+{
+    SignonIdentityInfo *info;
+    GVariant *item;
+
+    g_return_val_if_fail (iter != NULL, NULL);
+
+    if (iter->next >= iter->n_items)
+        return NULL;
+
+    item = g_variant_get_child_value (iter->list, iter->next++);
+    info = signon_identity_info_new_from_variant (item);
+    g_variant_unref (item);
+    return info;
 }
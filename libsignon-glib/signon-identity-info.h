@@ -37,6 +37,13 @@ G_BEGIN_DECLS
  */
 typedef struct _SignonIdentityInfo SignonIdentityInfo;
 
+/**
+ * SignonIdentityInfoIter:
+ *
+ * Opaque struct. Use the accessor functions below.
+ */
+typedef struct _SignonIdentityInfoIter SignonIdentityInfoIter;
+
 /**
  * SignonIdentityType:
  * @SIGNON_IDENTITY_TYPE_OTHER: an identity that is not an app, web or network
@@ -84,6 +91,13 @@ void signon_identity_info_set_access_control_list (SignonIdentityInfo *info,
 void signon_identity_info_set_identity_type (SignonIdentityInfo *info,
                                              SignonIdentityType type);
 
+GType signon_identity_info_iter_get_type (void) G_GNUC_CONST;
+
+SignonIdentityInfoIter *signon_identity_info_iter_ref (SignonIdentityInfoIter *iter);
+void signon_identity_info_iter_unref (SignonIdentityInfoIter *iter);
+guint signon_identity_info_iter_get_n_items (SignonIdentityInfoIter *iter);
+SignonIdentityInfo *signon_identity_info_iter_next (SignonIdentityInfoIter *iter);
+
 G_END_DECLS
 
 #endif /* _SIGNON_IDENTITY_INFO_H_ */
@@ -49,7 +49,8 @@ G_DEFINE_TYPE_WITH_CODE (SignonIdentity, signon_identity, G_TYPE_OBJECT,
 enum
 {
     PROP_0,
-    PROP_ID
+    PROP_ID,
+    PROP_CONTEXT
 };
 
 typedef enum {
@@ -66,19 +67,26 @@ typedef enum  {
 
 struct _SignonIdentityPrivate
 {
+    SignonContext *context;
     SsoIdentity *proxy;
     SsoAuthService *auth_service_proxy;
     GCancellable *cancellable;
 
-    SignonIdentityInfo *identity_info;
+    /* Shared with the other identities having the same id; NULL if the
+     * identity is not stored yet */
+    SignonIdentityInfoEntry *info_entry;
+    /* IdentityInfoCbData waiting for the in-flight GetInfo call, most recent
+     * first */
+    GSList *info_waiters;
 
     GSList *sessions;
     IdentityRegistrationState registration_state;
 
     gboolean removed;
     gboolean signed_out;
-    gboolean updated;
     gboolean first_registration;
+    /* Set if returned by signon_identity_get_from_db() */
+    gboolean interned;
 
     guint id;
 
@@ -93,6 +101,9 @@ enum {
 
 static guint signals[LAST_SIGNAL];
 
+/* How many identities signon_identity_new_from_db_many() registers at once */
+#define MAX_PARALLEL_LOADS 32
+
 #define SIGNON_IDENTITY_PRIV(obj) (SIGNON_IDENTITY(obj)->priv)
 
 typedef struct _IdentityStoreCredentialsCbData
@@ -100,6 +111,8 @@ typedef struct _IdentityStoreCredentialsCbData
     SignonIdentity *self;
     SignonIdentityStoreCredentialsCb cb;
     gpointer user_data;
+    /* What signond will have once the store succeeds */
+    SignonIdentityInfo *info;
 } IdentityStoreCredentialsCbData;
 
 typedef struct _IdentityStoreCredentialsData
@@ -151,6 +164,14 @@ typedef struct _IdentityVoidData
     gpointer cb_data;
 } IdentityVoidData;
 
+typedef struct _IdentityLoadManyData
+{
+    GPtrArray *identities;
+    /* Index of the next identity to be registered */
+    guint next;
+    guint in_flight;
+} IdentityLoadManyData;
+
 static void identity_check_remote_registration (SignonIdentity *self);
 static void identity_store_credentials_ready_cb (gpointer object, const GError *error, gpointer user_data);
 static void identity_store_credentials_reply (GObject *object,
@@ -169,6 +190,84 @@ static void identity_process_signout (SignonIdentity *self);
 static void identity_process_updated (SignonIdentity *self);
 static void identity_process_removed (SignonIdentity *self);
 
+static void
+identity_info_cb_data_free (gpointer cb_data)
+{
+    g_slice_free (IdentityInfoCbData, cb_data);
+}
+
+static void
+identity_store_credentials_cb_data_free (IdentityStoreCredentialsCbData *cb_data)
+{
+    signon_identity_info_free (cb_data->info);
+    g_slice_free (IdentityStoreCredentialsCbData, cb_data);
+}
+
+static void
+identity_set_id (SignonIdentity *self, guint id)
+{
+    SignonIdentityPrivate *priv = self->priv;
+
+    /* An interned identity which changes id is no longer the one for its old
+     * id */
+    if (priv->interned && priv->id != id)
+    {
+        signon_context_unintern_identity (priv->context, priv->id, self);
+        priv->interned = FALSE;
+    }
+
+    priv->id = id;
+
+    if (priv->info_entry != NULL && priv->info_entry->id != id)
+    {
+        signon_context_unref_identity_info (priv->context, priv->info_entry);
+        priv->info_entry = NULL;
+    }
+
+    if (priv->info_entry == NULL && id != 0 && priv->context != NULL)
+        priv->info_entry = signon_context_ref_identity_info (priv->context,
+                                                             id);
+}
+
+/* Drops the replies of the authentication sessions of this identity from
+ * the token cache */
+static void
+identity_invalidate_tokens (SignonIdentity *self)
+{
+    SignonIdentityPrivate *priv = self->priv;
+
+    if (priv->id != 0 && priv->context != NULL)
+        signon_context_invalidate_tokens (priv->context, priv->id);
+}
+
+/* Returns the cached info, or NULL if it needs to be retrieved */
+static SignonIdentityInfo *
+identity_get_cached_info (SignonIdentity *self)
+{
+    SignonIdentityInfoEntry *entry = self->priv->info_entry;
+
+    return entry != NULL ? entry->info : NULL;
+}
+
+/* Replaces the cached info, for all the identities with the same id; takes
+ * ownership of @info, which can be NULL to invalidate the cache */
+static void
+identity_set_cached_info (SignonIdentity *self, SignonIdentityInfo *info)
+{
+    SignonIdentityInfoEntry *entry = self->priv->info_entry;
+
+    if (entry == NULL)
+    {
+        if (info != NULL)
+            signon_identity_info_free (info);
+        return;
+    }
+
+    if (entry->info != NULL)
+        signon_identity_info_free (entry->info);
+    entry->info = info;
+}
+
 static GQuark
 identity_object_quark ()
 {
@@ -203,7 +302,10 @@ signon_identity_set_property (GObject *object,
     switch (property_id)
     {
     case PROP_ID:
-        self->priv->id = g_value_get_uint (value);
+        identity_set_id (self, g_value_get_uint (value));
+        break;
+    case PROP_CONTEXT:
+        self->priv->context = g_value_dup_object (value);
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -224,6 +326,9 @@ signon_identity_get_property (GObject *object,
     case PROP_ID:
         g_value_set_uint (value, self->priv->id);
         break;
+    case PROP_CONTEXT:
+        g_value_set_object (value, self->priv->context);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
         break;
@@ -240,16 +345,27 @@ signon_identity_init (SignonIdentity *identity)
                                                   SignonIdentityPrivate);
 
     priv = identity->priv;
-    priv->auth_service_proxy = sso_auth_service_get_instance();
     priv->cancellable = g_cancellable_new ();
     priv->registration_state = NOT_REGISTERED;
 
     priv->removed = FALSE;
     priv->signed_out = FALSE;
-    priv->updated = FALSE;
     priv->first_registration = TRUE;
 }
 
+static void
+signon_identity_constructed (GObject *object)
+{
+    SignonIdentityPrivate *priv = SIGNON_IDENTITY_PRIV (object);
+
+    G_OBJECT_CLASS (signon_identity_parent_class)->constructed (object);
+
+    if (priv->context == NULL)
+        priv->context = g_object_ref (signon_context_get_default ());
+
+    identity_set_id (SIGNON_IDENTITY (object), priv->id);
+}
+
 static void
 signon_identity_dispose (GObject *object)
 {
@@ -263,13 +379,24 @@ signon_identity_dispose (GObject *object)
         priv->cancellable = NULL;
     }
 
-    if (priv->identity_info)
+    if (priv->interned)
+    {
+        signon_context_unintern_identity (priv->context, priv->id, identity);
+        priv->interned = FALSE;
+    }
+
+    if (priv->info_entry)
     {
-        signon_identity_info_free (priv->identity_info);
-        priv->identity_info = NULL;
+        signon_context_unref_identity_info (priv->context, priv->info_entry);
+        priv->info_entry = NULL;
     }
 
+    /* The GetInfo call has been cancelled: the callbacks are not invoked */
+    g_slist_free_full (priv->info_waiters, identity_info_cb_data_free);
+    priv->info_waiters = NULL;
+
     g_clear_object (&priv->auth_service_proxy);
+    g_clear_object (&priv->context);
 
     if (priv->proxy)
     {
@@ -297,6 +424,7 @@ signon_identity_class_init (SignonIdentityClass *klass)
     GObjectClass *object_class = G_OBJECT_CLASS (klass);
     GParamSpec *pspec;
 
+    object_class->constructed = signon_identity_constructed;
     object_class->set_property = signon_identity_set_property;
     object_class->get_property = signon_identity_get_property;
 
@@ -312,6 +440,25 @@ signon_identity_class_init (SignonIdentityClass *klass)
                                      PROP_ID,
                                      pspec);
 
+    /**
+     * SignonIdentity:context:
+     *
+     * The #SignonContext used by the identity. If not set, the default
+     * context is used.
+     *
+     * Since: 1.15
+     */
+    pspec = g_param_spec_object ("context",
+                                 "Context",
+                                 "The signon context",
+                                 SIGNON_TYPE_CONTEXT,
+                                 G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+                                 G_PARAM_STATIC_STRINGS);
+
+    g_object_class_install_property (object_class,
+                                     PROP_CONTEXT,
+                                     pspec);
+
     g_type_class_add_private (object_class, sizeof (SignonIdentityPrivate));
 
     /**
@@ -381,12 +528,50 @@ identity_remote_object_destroyed_cb(GDBusProxy *proxy,
 
     priv->registration_state = NOT_REGISTERED;
 
-    signon_identity_info_free (priv->identity_info);
-    priv->identity_info = NULL;
+    identity_set_cached_info (self, NULL);
 
     priv->removed = FALSE;
     priv->signed_out = FALSE;
-    priv->updated = FALSE;
+}
+
+static void
+identity_proxy_new_cb (GObject *object, GAsyncResult *res,
+                       gpointer userdata)
+{
+    SignonIdentity *identity = (SignonIdentity*)userdata;
+    SignonIdentityPrivate *priv;
+    SsoIdentity *proxy;
+    GError *error = NULL;
+
+    proxy = sso_identity_proxy_new_finish (res, &error);
+    SIGNON_RETURN_IF_CANCELLED (error);
+
+    g_return_if_fail (SIGNON_IS_IDENTITY (identity));
+    priv = identity->priv;
+    g_return_if_fail (priv != NULL);
+
+    if (G_LIKELY (error == NULL))
+    {
+        priv->proxy = proxy;
+
+        priv->signal_info_updated =
+            g_signal_connect (priv->proxy,
+                              "info-updated",
+                              G_CALLBACK (identity_state_changed_cb),
+                              identity);
+
+        priv->signal_unregistered =
+            g_signal_connect (priv->proxy,
+                              "unregistered",
+                              G_CALLBACK (identity_remote_object_destroyed_cb),
+                              identity);
+    }
+    else
+        g_warning ("Failed to initialize Identity proxy: %s",
+                   error->message);
+
+    priv->registration_state = REGISTERED;
+    signon_proxy_set_ready (identity, identity_object_quark (), error);
 }
 
 static void
@@ -406,7 +591,6 @@ identity_registered (SignonIdentity *identity,
         GDBusConnection *connection;
         GDBusProxy *auth_service_proxy;
         const gchar *bus_name;
-        GError *proxy_error = NULL;
 
         DEBUG("%s: %s", G_STRFUNC, object_path);
         /*
@@ -415,45 +599,29 @@ identity_registered (SignonIdentity *identity,
          * */
         g_return_if_fail (priv->proxy == NULL);
 
-        auth_service_proxy = (GDBusProxy *)priv->auth_service_proxy;
-        connection = g_dbus_proxy_get_connection (auth_service_proxy);
-        bus_name = g_dbus_proxy_get_name (auth_service_proxy);
-
-        priv->proxy =
-            sso_identity_proxy_new_sync (connection,
-                                         G_DBUS_PROXY_FLAGS_NONE,
-                                         bus_name,
-                                         object_path,
-                                         priv->cancellable,
-                                         &proxy_error);
-        if (G_UNLIKELY (proxy_error != NULL))
-        {
-            g_warning ("Failed to initialize Identity proxy: %s",
-                       proxy_error->message);
-            g_clear_error (&proxy_error);
-        }
-
-        priv->signal_info_updated =
-            g_signal_connect (priv->proxy,
-                              "info-updated",
-                              G_CALLBACK (identity_state_changed_cb),
-                              identity);
-
-        priv->signal_unregistered =
-            g_signal_connect (priv->proxy,
-                              "unregistered",
-                              G_CALLBACK (identity_remote_object_destroyed_cb),
-                              identity);
-
         if (identity_data)
         {
             DEBUG("%s: ", G_STRFUNC);
-            priv->identity_info =
-                signon_identity_info_new_from_variant (identity_data);
+            identity_set_cached_info (identity,
+                signon_identity_info_new_from_variant (identity_data));
             g_variant_unref (identity_data);
         }
 
-        priv->updated = TRUE;
+        auth_service_proxy = (GDBusProxy *)priv->auth_service_proxy;
+        connection = g_dbus_proxy_get_connection (auth_service_proxy);
+        bus_name = g_dbus_proxy_get_name (auth_service_proxy);
+
+        /* The Identity interface has no properties: don't waste a round
+         * trip in loading them. The queued operations will be executed once
+         * the proxy is ready. */
+        sso_identity_proxy_new (connection,
+                                G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+                                bus_name,
+                                object_path,
+                                priv->cancellable,
+                                identity_proxy_new_cb,
+                                identity);
+        return;
     }
     else if (error->domain == G_DBUS_ERROR &&
              error->code == G_DBUS_ERROR_SERVICE_UNKNOWN)
@@ -556,6 +724,31 @@ identity_new_from_db_cb (GObject *object, GAsyncResult *res,
     g_free (object_path);
 }
 
+static void
+identity_auth_service_ready_cb (GObject *object, GAsyncResult *res,
+                                gpointer userdata)
+{
+    SignonIdentity *identity = (SignonIdentity*)userdata;
+    SsoAuthService *auth_service_proxy;
+    GError *error = NULL;
+
+    g_return_if_fail (identity != NULL);
+    DEBUG ("%s", G_STRFUNC);
+
+    auth_service_proxy = sso_auth_service_get_instance_finish (res, &error);
+    SIGNON_RETURN_IF_CANCELLED (error);
+
+    if (G_UNLIKELY (error != NULL))
+    {
+        identity_registered (identity, NULL, NULL, error);
+        return;
+    }
+
+    identity->priv->auth_service_proxy = auth_service_proxy;
+    identity->priv->registration_state = NOT_REGISTERED;
+    identity_check_remote_registration (identity);
+}
+
 static void
 identity_check_remote_registration (SignonIdentity *self)
 {
@@ -567,6 +760,18 @@ identity_check_remote_registration (SignonIdentity *self)
     if (priv->registration_state != NOT_REGISTERED)
         return;
 
+    if (priv->auth_service_proxy == NULL)
+    {
+        /* The registration will continue once the AuthService proxy is
+         * available */
+        priv->registration_state = PENDING_REGISTRATION;
+        sso_auth_service_get_instance_async (priv->context,
+                                             priv->cancellable,
+                                             identity_auth_service_ready_cb,
+                                             self);
+        return;
+    }
+
     if (priv->id != 0)
         sso_auth_service_call_get_identity (priv->auth_service_proxy,
                                             priv->id,
@@ -583,23 +788,30 @@ identity_check_remote_registration (SignonIdentity *self)
 }
 
 /**
- * signon_identity_new_from_db:
+ * signon_identity_new_from_db_with_context:
+ * @context: the #SignonContext to be used.
  * @id: identity ID.
  *
  * Construct an identity object associated with an existing identity
- * record.
+ * record, using @context to communicate with the signon daemon.
  *
  * Returns: an instance of a #SignonIdentity.
+ *
+ * Since: 1.15
  */
 SignonIdentity*
-signon_identity_new_from_db (guint32 id)
+signon_identity_new_from_db_with_context (SignonContext *context, guint32 id)
 {
     SignonIdentity *identity;
     DEBUG ("%s %d: %d\n", G_STRFUNC, __LINE__, id);
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (context), NULL);
     if (id == 0)
         return NULL;
 
-    identity = g_object_new (SIGNON_TYPE_IDENTITY, "id", id, NULL);
+    identity = g_object_new (SIGNON_TYPE_IDENTITY,
+                             "context", context,
+                             "id", id,
+                             NULL);
     g_return_val_if_fail (SIGNON_IS_IDENTITY (identity), NULL);
     g_return_val_if_fail (identity->priv != NULL, NULL);
 
@@ -610,17 +822,222 @@ signon_identity_new_from_db (guint32 id)
 }
 
 /**
- * signon_identity_new:
+ * signon_identity_get_from_db:
+ * @context: (allow-none): the #SignonContext to be used, or %NULL for the
+ * default context.
+ * @id: identity ID.
  *
- * Construct new, empty, identity object.
+ * Get an identity object associated with an existing identity record. Unlike
+ * signon_identity_new_from_db_with_context(), if a live identity object for
+ * @id was already returned by this function for the same @context, that
+ * object is returned again, so that its connection to the signon daemon and
+ * its cached data are shared by all the callers.
+ *
+ * Note that since the returned object might be shared, changes made on it
+ * (such as signing it out) are visible to all its users.
+ *
+ * Returns: (transfer full): an instance of a #SignonIdentity.
+ *
+ * Since: 1.15
+ */
+SignonIdentity*
+signon_identity_get_from_db (SignonContext *context, guint32 id)
+{
+    SignonIdentity *identity;
+
+    g_return_val_if_fail (context == NULL || SIGNON_IS_CONTEXT (context),
+                          NULL);
+    if (id == 0)
+        return NULL;
+
+    if (context == NULL)
+        context = signon_context_get_default ();
+
+    identity = signon_context_lookup_identity (context, id);
+    if (identity != NULL)
+        return g_object_ref (identity);
+
+    identity = signon_identity_new_from_db_with_context (context, id);
+    g_return_val_if_fail (identity != NULL, NULL);
+
+    signon_context_intern_identity (context, id, identity);
+    identity->priv->interned = TRUE;
+
+    return identity;
+}
+
+/**
+ * signon_identity_new_from_db:
+ * @id: identity ID.
+ *
+ * Construct an identity object associated with an existing identity
+ * record.
+ *
+ * Returns: an instance of a #SignonIdentity.
+ */
+SignonIdentity*
+signon_identity_new_from_db (guint32 id)
+{
+    return signon_identity_new_from_db_with_context (signon_context_get_default (),
+                                                     id);
+}
+
+static void
+identity_load_many_data_free (IdentityLoadManyData *data)
+{
+    g_ptr_array_unref (data->identities);
+    g_slice_free (IdentityLoadManyData, data);
+}
+
+static void identity_load_many_next (GTask *task);
+
+static void
+identity_load_many_ready_cb (gpointer object, const GError *error,
+                             gpointer user_data)
+{
+    GTask *task = user_data;
+    IdentityLoadManyData *data = g_task_get_task_data (task);
+
+    if (error != NULL)
+        DEBUG ("Identity %u not loaded: %s",
+               SIGNON_IDENTITY (object)->priv->id, error->message);
+
+    data->in_flight--;
+    identity_load_many_next (task);
+}
+
+static void
+identity_load_many_next (GTask *task)
+{
+    IdentityLoadManyData *data = g_task_get_task_data (task);
+    GCancellable *cancellable = g_task_get_cancellable (task);
+
+    while (data->next < data->identities->len &&
+           data->in_flight < MAX_PARALLEL_LOADS &&
+           !g_cancellable_is_cancelled (cancellable))
+    {
+        SignonIdentity *identity =
+            g_ptr_array_index (data->identities, data->next++);
+
+        /* This starts the registration of the identity */
+        data->in_flight++;
+        signon_proxy_call_when_ready (identity,
+                                      identity_object_quark (),
+                                      identity_load_many_ready_cb,
+                                      task);
+    }
+
+    if (data->in_flight > 0)
+        return;
+
+    if (!g_task_return_error_if_cancelled (task))
+        g_task_return_pointer (task, g_ptr_array_ref (data->identities),
+                               (GDestroyNotify) g_ptr_array_unref);
+    g_object_unref (task);
+}
+
+/**
+ * signon_identity_new_from_db_many:
+ * @context: (allow-none): the #SignonContext to be used, or %NULL for the
+ * default context.
+ * @ids: (array length=n_ids): the IDs of the identities; they must not be 0.
+ * @n_ids: the number of elements in @ids.
+ * @cancellable: (allow-none): optional #GCancellable object, %NULL to ignore.
+ * @callback: (scope async): a callback which will be called when all the
+ * identities have been loaded.
+ * @user_data: user data to be passed to the callback.
+ *
+ * Construct the identity objects associated with many existing identity
+ * records at once. The identities are registered with the signon daemon
+ * concurrently (but only a limited number at a time), and @callback is
+ * invoked once all of them are ready.
+ *
+ * An identity which could not be loaded is still part of the result: use
+ * signon_identity_get_last_error() on it to know why.
+ *
+ * Since: 1.15
+ */
+void
+signon_identity_new_from_db_many (SignonContext *context,
+                                  const guint32 *ids,
+                                  guint n_ids,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+    IdentityLoadManyData *data;
+    GTask *task;
+    guint i;
+
+    g_return_if_fail (context == NULL || SIGNON_IS_CONTEXT (context));
+    g_return_if_fail (ids != NULL || n_ids == 0);
+    for (i = 0; i < n_ids; i++)
+        g_return_if_fail (ids[i] != 0);
+
+    if (context == NULL)
+        context = signon_context_get_default ();
+
+    data = g_slice_new0 (IdentityLoadManyData);
+    data->identities = g_ptr_array_new_full (n_ids, g_object_unref);
+    for (i = 0; i < n_ids; i++)
+    {
+        /* Unlike signon_identity_new_from_db(), this does not register the
+         * identity right away */
+        SignonIdentity *identity = g_object_new (SIGNON_TYPE_IDENTITY,
+                                                 "context", context,
+                                                 "id", ids[i],
+                                                 NULL);
+        g_ptr_array_add (data->identities, identity);
+    }
+
+    task = g_task_new (context, cancellable, callback, user_data);
+    g_task_set_task_data (task, data,
+                          (GDestroyNotify) identity_load_many_data_free);
+    identity_load_many_next (task);
+}
+
+/**
+ * signon_identity_new_from_db_many_finish:
+ * @res: A #GAsyncResult obtained from the #GAsyncReadyCallback passed to
+ * signon_identity_new_from_db_many().
+ * @error: return location for error, or %NULL.
+ *
+ * Collect the result of the signon_identity_new_from_db_many() operation.
+ *
+ * Returns: (transfer full) (element-type SignonIdentity): an array holding
+ * a #SignonIdentity for each of the requested IDs, in the same order, or %NULL
+ * if the operation was cancelled.
+ *
+ * Since: 1.15
+ */
+GPtrArray *
+signon_identity_new_from_db_many_finish (GAsyncResult *res, GError **error)
+{
+    g_return_val_if_fail (G_IS_TASK (res), NULL);
+
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * signon_identity_new_with_context:
+ * @context: the #SignonContext to be used.
+ *
+ * Construct new, empty, identity object, using @context to communicate with
+ * the signon daemon.
  *
  * Returns: an instance of an #SignonIdentity.
+ *
+ * Since: 1.15
  */
 SignonIdentity*
-signon_identity_new ()
+signon_identity_new_with_context (SignonContext *context)
 {
     DEBUG ("%s %d", G_STRFUNC, __LINE__);
-    SignonIdentity *identity = g_object_new (SIGNON_TYPE_IDENTITY, NULL);
+    g_return_val_if_fail (SIGNON_IS_CONTEXT (context), NULL);
+
+    SignonIdentity *identity = g_object_new (SIGNON_TYPE_IDENTITY,
+                                             "context", context,
+                                             NULL);
     g_return_val_if_fail (SIGNON_IS_IDENTITY (identity), NULL);
     g_return_val_if_fail (identity->priv != NULL, NULL);
     identity_check_remote_registration (identity);
@@ -628,6 +1045,19 @@ signon_identity_new ()
     return identity;
 }
 
+/**
+ * signon_identity_new:
+ *
+ * Construct new, empty, identity object.
+ *
+ * Returns: an instance of an #SignonIdentity.
+ */
+SignonIdentity*
+signon_identity_new ()
+{
+    return signon_identity_new_with_context (signon_context_get_default ());
+}
+
 static void
 identity_session_object_destroyed_cb(gpointer data,
                                      GObject *where_the_session_was)
@@ -657,6 +1087,32 @@ SignonAuthSession *
 signon_identity_create_session(SignonIdentity *self,
                                const gchar *method,
                                GError **error)
+{
+    return signon_identity_create_session_with_flags (self, method,
+                                                      SIGNON_AUTH_SESSION_FLAG_NONE,
+                                                      error);
+}
+
+/**
+ * signon_identity_create_session_with_flags:
+ * @self: the #SignonIdentity.
+ * @method: method.
+ * @flags: #SignonAuthSessionFlags for the new session.
+ * @error: pointer to a location which will receive the error, if any.
+ *
+ * Creates an authentication session for this identity, like
+ * signon_identity_create_session() does; see signon_auth_session_new_full()
+ * for the meaning of @flags.
+ *
+ * Returns: (transfer full): a new #SignonAuthSession.
+ *
+ * Since: 1.15
+ */
+SignonAuthSession *
+signon_identity_create_session_with_flags (SignonIdentity *self,
+                                           const gchar *method,
+                                           SignonAuthSessionFlags flags,
+                                           GError **error)
 {
     g_return_val_if_fail (SIGNON_IS_IDENTITY (self), NULL);
 
@@ -693,9 +1149,12 @@ signon_identity_create_session(SignonIdentity *self,
         list = list->next;
     }
 
-    SignonAuthSession *session = signon_auth_session_new (priv->id,
-                                                          method,
-                                                          error);
+    SignonAuthSession *session =
+        signon_auth_session_new_full (priv->context,
+                                      priv->id,
+                                      method,
+                                      flags,
+                                      error);
     if (session)
     {
         DEBUG ("%s %d", G_STRFUNC, __LINE__);
@@ -715,6 +1174,31 @@ signon_identity_create_session(SignonIdentity *self,
     return session;
 }
 
+static void
+identity_store_info (SignonIdentity *self,
+                     const SignonIdentityInfo *info,
+                     SignonIdentityStoreCredentialsCb cb,
+                     gpointer user_data)
+{
+    IdentityStoreCredentialsCbData *cb_data;
+    IdentityStoreCredentialsData *operation_data;
+
+    cb_data = g_slice_new0 (IdentityStoreCredentialsCbData);
+    cb_data->self = self;
+    cb_data->cb = cb;
+    cb_data->user_data = user_data;
+    cb_data->info = signon_identity_info_copy (info);
+
+    operation_data = g_slice_new0 (IdentityStoreCredentialsData);
+    operation_data->info_variant = signon_identity_info_to_variant (info);
+    operation_data->cb_data = cb_data;
+
+    signon_proxy_call_when_ready (self,
+                                  identity_object_quark(),
+                                  identity_store_credentials_ready_cb,
+                                  operation_data);
+}
+
 /**
  * signon_identity_store_credentials_with_info:
  * @self: the #SignonIdentity.
@@ -730,26 +1214,11 @@ signon_identity_store_credentials_with_info(SignonIdentity *self,
                                             SignonIdentityStoreCredentialsCb cb,
                                             gpointer user_data)
 {
-    IdentityStoreCredentialsCbData *cb_data;
-    IdentityStoreCredentialsData *operation_data;
-
     DEBUG ();
     g_return_if_fail (SIGNON_IS_IDENTITY (self));
     g_return_if_fail (info != NULL);
 
-    cb_data = g_slice_new0 (IdentityStoreCredentialsCbData);
-    cb_data->self = self;
-    cb_data->cb = cb;
-    cb_data->user_data = user_data;
-
-    operation_data = g_slice_new0 (IdentityStoreCredentialsData);
-    operation_data->info_variant = signon_identity_info_to_variant (info);
-    operation_data->cb_data = cb_data;
-
-    signon_proxy_call_when_ready (self,
-                                  identity_object_quark(),
-                                  identity_store_credentials_ready_cb,
-                                  operation_data);
+    identity_store_info (self, info, cb, user_data);
 }
 
 /**
@@ -824,7 +1293,7 @@ identity_store_credentials_ready_cb (gpointer object, const GError *error, gpoin
             (cb_data->cb) (self, 0, error, cb_data->user_data);
         }
 
-        g_slice_free (IdentityStoreCredentialsCbData, cb_data);
+        identity_store_credentials_cb_data_free (cb_data);
     }
     else
     {
@@ -837,6 +1306,7 @@ identity_store_credentials_ready_cb (gpointer object, const GError *error, gpoin
                                  cb_data);
     }
 
+    g_variant_unref (operation_data->info_variant);
     g_slice_free (IdentityStoreCredentialsData, operation_data);
 }
 
@@ -860,8 +1330,6 @@ identity_store_credentials_reply (GObject *object, GAsyncResult *res,
 
     if (error == NULL)
     {
-        g_return_if_fail (priv->identity_info == NULL);
-
         GSList *slist = priv->sessions;
 
         while (slist)
@@ -874,6 +1342,12 @@ identity_store_credentials_reply (GObject *object, GAsyncResult *res,
         g_object_set (cb_data->self, "id", id, NULL);
         cb_data->self->priv->id = id;
 
+        /* signond has just sent the infoUpdated signal, which invalidated
+         * the cached info: replace it with what we have stored, to spare
+         * the next query_info() a round trip */
+        identity_set_cached_info (cb_data->self,
+            signon_identity_info_new_stored (cb_data->info, id));
+
         /*
          * if the previous state was REMOVED
          * then we need to reset it
@@ -887,7 +1361,7 @@ identity_store_credentials_reply (GObject *object, GAsyncResult *res,
     }
 
     g_clear_error(&error);
-    g_slice_free (IdentityStoreCredentialsCbData, cb_data);
+    identity_store_credentials_cb_data_free (cb_data);
 }
 
 static void
@@ -1039,9 +1513,9 @@ identity_process_updated (SignonIdentity *self)
     SignonIdentityPrivate *priv = self->priv;
     g_return_if_fail (priv->proxy != NULL);
 
-    signon_identity_info_free (priv->identity_info);
-    priv->identity_info = NULL;
-    priv->updated = FALSE;
+    identity_set_cached_info (self, NULL);
+    /* The tokens might have been obtained with the old credentials */
+    identity_invalidate_tokens (self);
 }
 
 static void
@@ -1058,8 +1532,8 @@ identity_process_removed (SignonIdentity *self)
         return;
 
     priv->removed = TRUE;
-    signon_identity_info_free (priv->identity_info);
-    priv->identity_info = NULL;
+    identity_set_cached_info (self, NULL);
+    identity_invalidate_tokens (self);
 
     g_object_set (self, "id", 0, NULL);
     priv->id = 0;
@@ -1077,6 +1551,8 @@ identity_process_signout(SignonIdentity *self)
     if (priv->signed_out == TRUE)
         return;
 
+    identity_invalidate_tokens (self);
+
     GSList *llink = priv->sessions;
     while (llink)
     {
@@ -1149,33 +1625,46 @@ identity_info_reply(GObject *object, GAsyncResult *res,
 {
     SsoIdentity *proxy = SSO_IDENTITY (object);
     GVariant *identity_data = NULL;
+    GSList *waiters, *list;
     DEBUG ("%d %s", __LINE__, __func__);
 
     GError *error = NULL;
-    IdentityInfoCbData *cb_data = (IdentityInfoCbData *)userdata;
-
-    g_return_if_fail (cb_data != NULL);
-    g_return_if_fail (cb_data->self != NULL);
-    g_return_if_fail (cb_data->self->priv != NULL);
-
-    SignonIdentityPrivate *priv = cb_data->self->priv;
+    SignonIdentity *self = (SignonIdentity *)userdata;
 
     sso_identity_call_get_info_finish (proxy, &identity_data, res, &error);
     SIGNON_RETURN_IF_CANCELLED (error);
-    priv->identity_info =
-        signon_identity_info_new_from_variant (identity_data);
-    if (identity_data != NULL)
+
+    g_return_if_fail (SIGNON_IS_IDENTITY (self));
+    SignonIdentityPrivate *priv = self->priv;
+    g_return_if_fail (priv != NULL);
+
+    if (G_LIKELY (error == NULL))
+    {
+        identity_set_cached_info (self,
+            signon_identity_info_new_from_variant (identity_data));
         g_variant_unref (identity_data);
+    }
 
-    if (cb_data->cb)
+    /* Deliver the reply to all the callers which were waiting for it, in the
+     * order they made their requests; the callbacks might drop the last
+     * reference to the identity. */
+    g_object_ref (self);
+    waiters = g_slist_reverse (priv->info_waiters);
+    priv->info_waiters = NULL;
+    for (list = waiters; list != NULL; list = list->next)
     {
-        (cb_data->cb) (cb_data->self, priv->identity_info, error, cb_data->user_data);
+        IdentityInfoCbData *cb_data = list->data;
+
+        if (cb_data->cb)
+        {
+            (cb_data->cb) (self, error ? NULL : identity_get_cached_info (self),
+                           error, cb_data->user_data);
+        }
     }
+    g_slist_free_full (waiters, identity_info_cb_data_free);
+    g_object_unref (self);
 
     g_clear_error(&error);
-    g_slice_free (IdentityInfoCbData, cb_data);
-
-    priv->updated = TRUE;
 }
 
 static void
@@ -1195,6 +1684,7 @@ identity_info_ready_cb(gpointer object, const GError *error, gpointer user_data)
 
     IdentityInfoCbData *cb_data = operation_data->cb_data;
     g_return_if_fail (cb_data != NULL);
+    g_slice_free (IdentityVoidData, operation_data);
 
     if (priv->removed == TRUE)
     {
@@ -1220,26 +1710,30 @@ identity_info_ready_cb(gpointer object, const GError *error, gpointer user_data)
             (cb_data->cb) (self, NULL, error, cb_data->user_data);
         }
     }
-    else if (priv->updated == FALSE)
+    else if (identity_get_cached_info (self) == NULL)
     {
         g_return_if_fail (priv->proxy != NULL);
-        sso_identity_call_get_info (priv->proxy,
-                                    priv->cancellable,
-                                    identity_info_reply,
-                                    cb_data);
+
+        /* Only one GetInfo call at a time: the other callers just wait for
+         * its reply */
+        priv->info_waiters = g_slist_prepend (priv->info_waiters, cb_data);
+        if (priv->info_waiters->next == NULL)
+            sso_identity_call_get_info (priv->proxy,
+                                        priv->cancellable,
+                                        identity_info_reply,
+                                        self);
+        return;
     }
     else
     {
         if (cb_data->cb)
         {
-            (cb_data->cb) (self, priv->identity_info, error, cb_data->user_data);
+            (cb_data->cb) (self, identity_get_cached_info (self), error,
+                           cb_data->user_data);
         }
     }
 
-    if (priv->updated || priv->removed)
-        g_slice_free (IdentityInfoCbData, cb_data);
-
-    g_slice_free (IdentityVoidData, operation_data);
+    identity_info_cb_data_free (cb_data);
 }
 
 static void
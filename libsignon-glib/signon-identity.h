@@ -27,6 +27,7 @@
 #define _SIGNON_IDENTITY_H_
 
 #include <libsignon-glib/signon-auth-session.h>
+#include <libsignon-glib/signon-context.h>
 #include <libsignon-glib/signon-identity-info.h>
 #include <glib-object.h>
 
@@ -105,12 +106,30 @@ GType signon_identity_get_type (void) G_GNUC_CONST;
 
 SignonIdentity *signon_identity_new_from_db (guint32 id);
 SignonIdentity *signon_identity_new ();
+SignonIdentity *signon_identity_new_from_db_with_context (SignonContext *context,
+                                                          guint32 id);
+SignonIdentity *signon_identity_new_with_context (SignonContext *context);
+SignonIdentity *signon_identity_get_from_db (SignonContext *context,
+                                             guint32 id);
+void signon_identity_new_from_db_many (SignonContext *context,
+                                       const guint32 *ids,
+                                       guint n_ids,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data);
+GPtrArray *signon_identity_new_from_db_many_finish (GAsyncResult *res,
+                                                    GError **error);
 
 const GError *signon_identity_get_last_error (SignonIdentity *identity);
 
 SignonAuthSession *signon_identity_create_session(SignonIdentity *self,
                                                   const gchar *method,
                                                   GError **error);
+SignonAuthSession *
+signon_identity_create_session_with_flags (SignonIdentity *self,
+                                           const gchar *method,
+                                           SignonAuthSessionFlags flags,
+                                           GError **error);
 
 /**
  * SignonIdentityStoreCredentialsCb:
@@ -43,8 +43,11 @@
 
 G_BEGIN_DECLS
 
-struct _SignonIdentityInfo
+/* The fields of a SignonIdentityInfo: they are shared among its copies, until
+ * one of them is modified. */
+typedef struct _SignonIdentityInfoData
 {
+    volatile gint ref_count;
     gint id;
     gchar *username;
     gchar *secret;
@@ -54,8 +57,36 @@ struct _SignonIdentityInfo
     gchar **realms;
     gchar **access_control_list;
     gint type;
+
+    /* Values received from signond and not decoded yet: each of them is
+     * dropped once the corresponding field above is decoded or set. The
+     * strings are never copied: they point into these variants. */
+    GVariant *username_variant;
+    GVariant *secret_variant;
+    GVariant *caption_variant;
+    GVariant *methods_variant;
+    GVariant *realms_variant;
+    GVariant *acl_variant;
+
+    /* Result of signon_identity_info_to_variant(), kept until the next
+     * modification */
+    GVariant *serialized;
+} SignonIdentityInfoData;
+
+struct _SignonIdentityInfo
+{
+    SignonIdentityInfoData *data;
 };
 
+/* Identity info shared by all the live SignonIdentity objects of a
+ * SignonContext which have the same id */
+typedef struct {
+    guint32 id;
+    gint ref_count;
+    /* NULL if not retrieved yet, or outdated */
+    SignonIdentityInfo *info;
+} SignonIdentityInfoEntry;
+
 G_GNUC_INTERNAL
 SignonIdentityInfo *
 signon_identity_info_new_from_variant (GVariant *variant);
@@ -64,6 +95,14 @@ G_GNUC_INTERNAL
 GVariant *
 signon_identity_info_to_variant (const SignonIdentityInfo *self);
 
+G_GNUC_INTERNAL
+SignonIdentityInfo *
+signon_identity_info_new_stored (const SignonIdentityInfo *info, guint32 id);
+
+G_GNUC_INTERNAL
+SignonIdentityInfoIter *
+signon_identity_info_iter_new (GVariant *list);
+
 G_GNUC_INTERNAL
 void signon_identity_info_set_methods (SignonIdentityInfo *self,
                                        const GHashTable *methods);
@@ -72,6 +111,94 @@ G_GNUC_INTERNAL
 void signon_auth_session_set_id(SignonAuthSession* self,
                                 gint32 id);
 
+G_GNUC_INTERNAL
+void signon_context_query_methods_async (SignonContext *self,
+                                         GCancellable *cancellable,
+                                         GAsyncReadyCallback callback,
+                                         gpointer user_data);
+G_GNUC_INTERNAL
+gchar **signon_context_query_methods_finish (SignonContext *self,
+                                             GAsyncResult *res,
+                                             GError **error);
+
+G_GNUC_INTERNAL
+void signon_context_query_mechanisms_async (SignonContext *self,
+                                            const gchar *method,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback,
+                                            gpointer user_data);
+G_GNUC_INTERNAL
+gchar **signon_context_query_mechanisms_finish (SignonContext *self,
+                                                GAsyncResult *res,
+                                                GError **error);
+
+G_GNUC_INTERNAL
+SignonIdentityInfoEntry *
+signon_context_ref_identity_info (SignonContext *self, guint32 id);
+G_GNUC_INTERNAL
+void signon_context_unref_identity_info (SignonContext *self,
+                                         SignonIdentityInfoEntry *entry);
+
+G_GNUC_INTERNAL
+SignonIdentity *signon_context_lookup_identity (SignonContext *self,
+                                                guint32 id);
+G_GNUC_INTERNAL
+void signon_context_intern_identity (SignonContext *self, guint32 id,
+                                     SignonIdentity *identity);
+G_GNUC_INTERNAL
+void signon_context_unintern_identity (SignonContext *self, guint32 id,
+                                       SignonIdentity *identity);
+
+G_GNUC_INTERNAL
+void signon_context_pool_auth_session (SignonContext *self,
+                                       guint32 id,
+                                       const gchar *method,
+                                       GDBusProxy *proxy);
+G_GNUC_INTERNAL
+GDBusProxy *signon_context_take_auth_session (SignonContext *self,
+                                              guint32 id,
+                                              const gchar *method);
+
+G_GNUC_INTERNAL
+guint signon_context_get_token_cache_ttl (SignonContext *self);
+G_GNUC_INTERNAL
+GVariant *signon_context_lookup_token (SignonContext *self,
+                                       const gchar *key);
+G_GNUC_INTERNAL
+void signon_context_store_token (SignonContext *self, const gchar *key,
+                                 guint32 id, GVariant *reply);
+G_GNUC_INTERNAL
+void signon_context_invalidate_tokens (SignonContext *self, guint32 id);
+
+G_GNUC_INTERNAL
+gboolean signon_context_join_process (SignonContext *self, const gchar *key,
+                                      GTask *task);
+G_GNUC_INTERNAL
+gboolean signon_context_leave_process (SignonContext *self, const gchar *key,
+                                       GTask *task);
+G_GNUC_INTERNAL
+GQueue *signon_context_complete_process (SignonContext *self,
+                                         const gchar *key);
+
+/* The scheduling lanes of the process requests, by SignonPriority */
+#define SIGNON_PRIORITY_N_LANES 3
+#define SIGNON_PRIORITY_LANE(priority) \
+    ((guint)((priority) - SIGNON_PRIORITY_BACKGROUND))
+
+G_GNUC_INTERNAL
+void signon_context_adjust_queue_depth (SignonContext *self,
+                                        SignonPriority priority,
+                                        gint delta);
+G_GNUC_INTERNAL
+gboolean signon_context_acquire_process_slot (SignonContext *self,
+                                              SignonAuthSession *session,
+                                              SignonPriority priority);
+G_GNUC_INTERNAL
+void signon_context_release_process_slot (SignonContext *self,
+                                          SignonPriority priority);
+G_GNUC_INTERNAL
+void signon_auth_session_process_next (SignonAuthSession *self);
+
 G_END_DECLS
 
 #endif
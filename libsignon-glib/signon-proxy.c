@@ -26,19 +26,36 @@
 #include "signon-proxy.h"
 #include "signon-internals.h"
 
+#include <gio/gio.h>
+
 G_DEFINE_INTERFACE (SignonProxy, signon_proxy, G_TYPE_OBJECT)
 
 typedef struct {
+    /* Embedded in the structure so that queueing doesn't allocate */
+    GList link;
     SignonReadyCb callback;
     gpointer user_data;
+    /* Monotonic time, or 0 */
+    gint64 deadline;
 } SignonReadyCbData;
 
 typedef struct {
     gpointer self;
-    GSList *callbacks;
+    GQueue callbacks;
     GSource *idle_source;
+    /* Runs the queued callbacks once the object is ready, at the next main
+     * loop iteration; it is created once, and armed whenever a callback is
+     * queued */
+    GSource *dispatch_source;
+    /* Fires at the earliest deadline of the callbacks */
+    GSource *deadline_source;
+    gint64 next_deadline;
 } SignonReadyData;
 
+static void signon_ready_data_schedule_deadline (SignonReadyData *rd);
+static void signon_ready_data_set_deadline (SignonReadyData *rd,
+                                            gint64 deadline);
+
 static void
 signon_proxy_default_init (SignonProxyInterface *iface)
 {
@@ -67,23 +84,113 @@ _signon_proxy_error_quark()
   return quark;
 }
 
+static void
+signon_ready_cb_data_invoke (SignonReadyCbData *cb, gpointer self,
+                             const GError *error)
+{
+    GError *timeout_error = NULL;
+
+    /* Operations which have waited too long fail without being run */
+    if (cb->deadline != 0 && cb->deadline <= g_get_monotonic_time ())
+    {
+        timeout_error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                                             "Operation timed out");
+        error = timeout_error;
+    }
+
+    cb->callback (self, error, cb->user_data);
+    g_slice_free (SignonReadyCbData, cb);
+    g_clear_error (&timeout_error);
+}
+
 static void
 signon_proxy_invoke_ready_callbacks (SignonReadyData *rd, const GError *error)
 {
-    GSList *list;
-    /* Make a copy of the callbacks list and erase the pointer in the
-     * structure, to ensure that we won't invoke the same callback twice. */
-    GSList *callbacks = rd->callbacks;
-    rd->callbacks = NULL;
+    GList *link;
+    /* Take over the queued callbacks and empty the queue in the structure,
+     * to ensure that we won't invoke the same callback twice. */
+    GQueue callbacks = rd->callbacks;
+    g_queue_init (&rd->callbacks);
+
+    signon_ready_data_set_deadline (rd, 0);
+
+    while ((link = g_queue_pop_head_link (&callbacks)) != NULL)
+        signon_ready_cb_data_invoke (link->data, rd->self, error);
+}
+
+static gboolean
+signon_ready_data_deadline_cb (gpointer user_data)
+{
+    SignonReadyData *rd = user_data;
+    GQueue expired = G_QUEUE_INIT;
+    GList *link, *next;
+    gint64 now = g_get_monotonic_time ();
+    gpointer self = rd->self;
+
+    g_source_unref (rd->deadline_source);
+    rd->deadline_source = NULL;
+    rd->next_deadline = 0;
+
+    for (link = rd->callbacks.head; link != NULL; link = next)
+    {
+        SignonReadyCbData *cb = link->data;
+
+        next = link->next;
+        if (cb->deadline != 0 && cb->deadline <= now)
+        {
+            g_queue_unlink (&rd->callbacks, link);
+            g_queue_push_tail_link (&expired, link);
+        }
+    }
+    signon_ready_data_schedule_deadline (rd);
+
+    /* The callbacks might drop the last reference on the object */
+    g_object_ref (self);
+    while ((link = g_queue_pop_head_link (&expired)) != NULL)
+        signon_ready_cb_data_invoke (link->data, self, NULL);
+    g_object_unref (self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+signon_ready_data_set_deadline (SignonReadyData *rd, gint64 deadline)
+{
+    gint64 delay;
 
-    for (list = callbacks; list != NULL; list = list->next)
+    if (rd->deadline_source)
     {
-        SignonReadyCbData *cb = list->data;
+        g_source_destroy (rd->deadline_source);
+        g_source_unref (rd->deadline_source);
+        rd->deadline_source = NULL;
+    }
+    rd->next_deadline = deadline;
+    if (deadline == 0) return;
+
+    delay = MAX (deadline - g_get_monotonic_time (), 0);
+    rd->deadline_source =
+        g_timeout_source_new ((guint) MIN ((delay + 999) / 1000, G_MAXUINT));
+    g_source_set_callback (rd->deadline_source,
+                           signon_ready_data_deadline_cb, rd, NULL);
+    g_source_attach (rd->deadline_source,
+                     g_main_context_get_thread_default ());
+}
+
+static void
+signon_ready_data_schedule_deadline (SignonReadyData *rd)
+{
+    GList *link;
+    gint64 deadline = 0;
+
+    for (link = rd->callbacks.head; link != NULL; link = link->next)
+    {
+        SignonReadyCbData *cb = link->data;
 
-        cb->callback (rd->self, error, cb->user_data);
-        g_slice_free (SignonReadyCbData, cb);
+        if (cb->deadline != 0 && (deadline == 0 || cb->deadline < deadline))
+            deadline = cb->deadline;
     }
-    g_slist_free (callbacks);
+
+    signon_ready_data_set_deadline (rd, deadline);
 }
 
 static void
@@ -101,14 +208,29 @@ signon_ready_data_free (SignonReadyData *rd)
         g_source_destroy (rd->idle_source);
         rd->idle_source = NULL;
     }
+    if (rd->dispatch_source)
+    {
+        GMainContext *context = g_source_get_context (rd->dispatch_source);
+        g_source_destroy (rd->dispatch_source);
+        g_source_unref (rd->dispatch_source);
+        g_main_context_unref (context);
+        rd->dispatch_source = NULL;
+    }
+    signon_ready_data_set_deadline (rd, 0);
     g_slice_free (SignonReadyData, rd);
 }
 
 static gboolean
-signon_proxy_call_when_ready_idle (SignonReadyData *rd)
+signon_proxy_is_ready (gpointer object)
 {
-    if (GPOINTER_TO_INT (g_object_get_qdata((GObject*)rd->self,
-                           _signon_proxy_ready_quark())) == TRUE)
+    return GPOINTER_TO_INT (g_object_get_qdata ((GObject *)object,
+                                _signon_proxy_ready_quark ())) == TRUE;
+}
+
+static void
+signon_ready_data_dispatch (SignonReadyData *rd)
+{
+    if (signon_proxy_is_ready (rd->self))
     {
         //TODO: specify the last error in object initialization
         GError * err = g_object_get_qdata((GObject*)rd->self,
@@ -119,12 +241,69 @@ signon_proxy_call_when_ready_idle (SignonReadyData *rd)
     {
         signon_proxy_setup (SIGNON_PROXY (rd->self));
     }
+}
+
+static gboolean
+signon_proxy_call_when_ready_idle (SignonReadyData *rd)
+{
+    signon_ready_data_dispatch (rd);
 
     g_main_context_unref (g_source_get_context (rd->idle_source));
     rd->idle_source = NULL;
     return FALSE;
 }
 
+static gboolean
+signon_ready_data_dispatch_cb (gpointer user_data)
+{
+    SignonReadyData *rd = user_data;
+    gpointer self = rd->self;
+
+    /* Disarm the source before running the callbacks, which might queue
+     * new ones */
+    g_source_set_ready_time (rd->dispatch_source, -1);
+
+    /* The callbacks might drop the last reference on the object */
+    g_object_ref (self);
+    signon_ready_data_dispatch (rd);
+    g_object_unref (self);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+signon_ready_data_dispatch_source_dispatch (GSource *source,
+                                            GSourceFunc callback,
+                                            gpointer user_data)
+{
+    return callback (user_data);
+}
+
+/* Dispatched only when its ready time is set */
+static GSourceFuncs signon_ready_data_dispatch_funcs = {
+    NULL,
+    NULL,
+    signon_ready_data_dispatch_source_dispatch,
+    NULL,
+};
+
+/* Arms the source which runs the callbacks of a ready object, creating it on
+ * first use */
+static void
+signon_ready_data_arm_dispatch (SignonReadyData *rd)
+{
+    if (!rd->dispatch_source)
+    {
+        rd->dispatch_source = g_source_new (&signon_ready_data_dispatch_funcs,
+                                            sizeof (GSource));
+        g_source_set_priority (rd->dispatch_source, G_PRIORITY_DEFAULT);
+        g_source_set_callback (rd->dispatch_source,
+                               signon_ready_data_dispatch_cb, rd, NULL);
+        g_source_attach (rd->dispatch_source,
+                         g_main_context_ref_thread_default ());
+    }
+    g_source_set_ready_time (rd->dispatch_source, 0);
+}
+
 void
 signon_proxy_setup (gpointer self)
 {
@@ -142,6 +321,19 @@ signon_proxy_setup (gpointer self)
 void
 signon_proxy_call_when_ready (gpointer object, GQuark quark, SignonReadyCb callback,
                               gpointer user_data)
+{
+    signon_proxy_call_when_ready_with_deadline (object, quark, callback,
+                                                user_data, 0);
+}
+
+/* Like signon_proxy_call_when_ready(), but if the object is not ready by
+ * @deadline (in monotonic time, 0 for none), @callback is invoked with a
+ * G_IO_ERROR_TIMED_OUT error. */
+void
+signon_proxy_call_when_ready_with_deadline (gpointer object, GQuark quark,
+                                            SignonReadyCb callback,
+                                            gpointer user_data,
+                                            gint64 deadline)
 {
     SignonReadyData *rd;
     SignonReadyCbData *cb;
@@ -151,22 +343,39 @@ signon_proxy_call_when_ready (gpointer object, GQuark quark, SignonReadyCb callb
     g_return_if_fail (callback != NULL);
 
     cb = g_slice_new (SignonReadyCbData);
+    cb->link.data = cb;
+    cb->link.prev = cb->link.next = NULL;
     cb->callback = callback;
     cb->user_data = user_data;
+    cb->deadline = deadline;
 
     rd = g_object_get_qdata ((GObject *)object, quark);
     if (!rd)
     {
         rd = g_slice_new (SignonReadyData);
         rd->self = object;
-        rd->callbacks = NULL;
+        g_queue_init (&rd->callbacks);
         rd->idle_source = NULL;
+        rd->dispatch_source = NULL;
+        rd->deadline_source = NULL;
+        rd->next_deadline = 0;
         g_object_set_qdata_full ((GObject *)object, quark, rd,
                                  (GDestroyNotify)signon_ready_data_free);
     }
 
-    rd->callbacks = g_slist_append (rd->callbacks, cb);
-    if (!rd->idle_source)
+    g_queue_push_tail_link (&rd->callbacks, &cb->link);
+    /* Only an earlier deadline requires moving the timer */
+    if (deadline != 0 &&
+        (rd->next_deadline == 0 || deadline < rd->next_deadline))
+        signon_ready_data_set_deadline (rd, deadline);
+    if (signon_proxy_is_ready (object))
+    {
+        /* There's nothing to wait for, but the callbacks are still invoked
+         * asynchronously: they run at the next main loop iteration, along
+         * with the D-Bus replies rather than after the idle work. */
+        signon_ready_data_arm_dispatch (rd);
+    }
+    else if (!rd->idle_source)
     {
         rd->idle_source = g_idle_source_new ();
         g_source_set_callback (rd->idle_source,
@@ -51,6 +51,11 @@ void signon_proxy_setup (gpointer self);
 G_GNUC_INTERNAL
 void signon_proxy_call_when_ready (gpointer self, GQuark quark,
                                    SignonReadyCb callback, gpointer user_data);
+G_GNUC_INTERNAL
+void signon_proxy_call_when_ready_with_deadline (gpointer self, GQuark quark,
+                                                 SignonReadyCb callback,
+                                                 gpointer user_data,
+                                                 gint64 deadline);
 
 G_GNUC_INTERNAL
 void signon_proxy_set_ready (gpointer self, GQuark quark, GError *error);
@@ -0,0 +1,648 @@
+/* vi: set et sw=4 ts=4 cino=t0,(0: */
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This file is part of libsignon-glib
+ *
+ * Copyright (C) 2018 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/**
+ * SECTION:signon-token-refresher
+ * @title: SignonTokenRefresher
+ * @short_description: Keeps authentication tokens fresh in the background.
+ *
+ * A #SignonTokenRefresher obtains authentication tokens through
+ * signon_auth_session_process_async() and renews them before they expire, so
+ * that the application can always read a valid token with
+ * signon_token_refresher_get_token() without waiting for signond.
+ *
+ * Tokens are registered with signon_token_refresher_add(). The first token is
+ * requested right away; afterwards, each token is renewed once 70% to 80% of
+ * its lifetime has elapsed (the random part spreads the refreshes of tokens
+ * obtained at the same time). The lifetime is read from the "ExpiresIn" field
+ * of the reply, or taken from #SignonTokenRefresher:default-lifetime. Failed
+ * refreshes are retried with an exponential backoff, while the previous
+ * token is still served until it expires. At most
+ * #SignonTokenRefresher:max-concurrent refreshes are in progress at any time.
+ *
+ * Refreshes never interact with the user: %SIGNON_SESSION_DATA_UI_POLICY is
+ * always set to %SIGNON_POLICY_NO_USER_INTERACTION. They are made with
+ * %SIGNON_PRIORITY_BACKGROUND, so that they don't delay interactive requests
+ * sharing the same #SignonContext.
+ *
+ * Since: 1.15
+ */
+
+#include "signon-token-refresher.h"
+#include "signon-auth-session.h"
+#include "signon-internals.h"
+#include "signon-utils.h"
+
+G_DEFINE_TYPE (SignonTokenRefresher, signon_token_refresher, G_TYPE_OBJECT);
+
+enum
+{
+    PROP_0,
+    PROP_CONTEXT,
+    PROP_MAX_CONCURRENT,
+    PROP_DEFAULT_LIFETIME
+};
+
+enum
+{
+    TOKEN_CHANGED,
+    LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+#define DEFAULT_MAX_CONCURRENT 2
+#define DEFAULT_TOKEN_LIFETIME 3600
+/* A token is refreshed when a fraction between REFRESH_POINT and
+ * REFRESH_POINT + REFRESH_JITTER of its lifetime has elapsed */
+#define REFRESH_POINT 0.7
+#define REFRESH_JITTER 0.1
+/* Retry delays after a failure, in seconds */
+#define BACKOFF_MIN 1
+#define BACKOFF_MAX 300
+
+typedef struct {
+    SignonTokenRefresher *refresher;
+    guint token_id;
+    SignonAuthSession *session;
+    gchar *mechanism;
+    GVariant *session_data;
+    GVariant *token;
+    /* Monotonic time */
+    gint64 expiry;
+    guint failures;
+    GSource *timeout_source;
+    /* Set while a refresh is in progress */
+    GCancellable *cancellable;
+    gboolean queued;
+    /* Set if the token is removed while a refresh is in progress */
+    gboolean removed;
+} RefreshToken;
+
+struct _SignonTokenRefresherPrivate
+{
+    SignonContext *context;
+    GMainContext *main_context;
+    /* token id -> RefreshToken */
+    GHashTable *tokens;
+    guint last_token_id;
+    /* Tokens waiting for a refresh slot, in order */
+    GQueue due;
+    guint running;
+    guint max_concurrent;
+    guint default_lifetime;
+};
+
+static void refresher_run_due (SignonTokenRefresher *self);
+
+static void
+refresh_token_free (RefreshToken *token)
+{
+    if (token->timeout_source != NULL)
+    {
+        g_source_destroy (token->timeout_source);
+        g_source_unref (token->timeout_source);
+    }
+    g_object_unref (token->session);
+    g_free (token->mechanism);
+    g_variant_unref (token->session_data);
+    if (token->token != NULL)
+        g_variant_unref (token->token);
+    g_slice_free (RefreshToken, token);
+}
+
+/* Destroy notify of the tokens table */
+static void
+refresh_token_release (RefreshToken *token)
+{
+    SignonTokenRefresherPrivate *priv = token->refresher->priv;
+
+    if (token->queued)
+        g_queue_remove (&priv->due, token);
+
+    if (token->cancellable != NULL)
+    {
+        /* Freed when the refresh completes */
+        token->removed = TRUE;
+        g_cancellable_cancel (token->cancellable);
+    }
+    else
+    {
+        refresh_token_free (token);
+    }
+}
+
+static void
+refresh_token_enqueue (RefreshToken *token)
+{
+    SignonTokenRefresherPrivate *priv = token->refresher->priv;
+
+    if (token->queued || token->cancellable != NULL) return;
+
+    g_queue_push_tail (&priv->due, token);
+    token->queued = TRUE;
+}
+
+static gboolean
+refresh_token_timeout_cb (gpointer user_data)
+{
+    RefreshToken *token = user_data;
+    SignonTokenRefresher *self = token->refresher;
+
+    g_source_unref (token->timeout_source);
+    token->timeout_source = NULL;
+
+    refresh_token_enqueue (token);
+    refresher_run_due (self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+refresh_token_schedule (RefreshToken *token, gdouble delay)
+{
+    SignonTokenRefresherPrivate *priv = token->refresher->priv;
+    guint interval;
+
+    if (token->timeout_source != NULL)
+    {
+        g_source_destroy (token->timeout_source);
+        g_source_unref (token->timeout_source);
+    }
+
+    /* delay is in seconds, the interval in milliseconds */
+    interval = (guint) MIN (delay * 1000, G_MAXUINT);
+    DEBUG ("Refreshing token %u in %u ms", token->token_id, interval);
+
+    token->timeout_source = g_timeout_source_new (interval);
+    g_source_set_callback (token->timeout_source, refresh_token_timeout_cb,
+                           token, NULL);
+    g_source_attach (token->timeout_source, priv->main_context);
+}
+
+static void
+refresh_token_succeeded (RefreshToken *token, GVariant *reply)
+{
+    SignonTokenRefresher *self = token->refresher;
+    gint64 lifetime;
+
+    lifetime = signon_reply_get_expires_in (reply);
+    if (lifetime <= 0)
+        lifetime = self->priv->default_lifetime;
+
+    if (token->token != NULL)
+        g_variant_unref (token->token);
+    token->token = reply;
+    token->expiry = g_get_monotonic_time () + lifetime * G_USEC_PER_SEC;
+    token->failures = 0;
+
+    refresh_token_schedule (token, lifetime *
+                            g_random_double_range (REFRESH_POINT,
+                                                   REFRESH_POINT +
+                                                   REFRESH_JITTER));
+
+    g_signal_emit (self, signals[TOKEN_CHANGED], 0, token->token_id);
+}
+
+static void
+refresh_token_failed (RefreshToken *token, const GError *error)
+{
+    guint backoff;
+
+    DEBUG ("Refresh of token %u failed: %s", token->token_id, error->message);
+
+    /* Exponential backoff, randomized to between half and the full delay */
+    backoff = BACKOFF_MIN << MIN (token->failures, 16);
+    backoff = MIN (backoff, BACKOFF_MAX);
+    token->failures++;
+
+    refresh_token_schedule (token,
+                            backoff * g_random_double_range (0.5, 1.0));
+}
+
+static void
+refresh_token_process_cb (GObject *source_object,
+                          GAsyncResult *res,
+                          gpointer user_data)
+{
+    RefreshToken *token = user_data;
+    SignonTokenRefresher *self = token->refresher;
+    GVariant *reply;
+    GError *error = NULL;
+
+    reply = signon_auth_session_process_finish (SIGNON_AUTH_SESSION (source_object),
+                                                res, &error);
+    self->priv->running--;
+    g_clear_object (&token->cancellable);
+
+    if (token->removed)
+    {
+        refresh_token_free (token);
+        if (reply != NULL) g_variant_unref (reply);
+        g_clear_error (&error);
+    }
+    else if (reply != NULL)
+    {
+        refresh_token_succeeded (token, reply);
+    }
+    else
+    {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            refresh_token_failed (token, error);
+        g_error_free (error);
+    }
+
+    refresher_run_due (self);
+    g_object_unref (self);
+}
+
+static GVariant *
+refresh_token_build_session_data (RefreshToken *token)
+{
+    GVariantBuilder builder;
+    GVariantIter iter;
+    const gchar *key;
+    GVariant *value;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_iter_init (&iter, token->session_data);
+    while (g_variant_iter_next (&iter, "{&sv}", &key, &value))
+    {
+        if (g_strcmp0 (key, SIGNON_SESSION_DATA_UI_POLICY) != 0 &&
+            g_strcmp0 (key, SIGNON_SESSION_DATA_RENEW_TOKEN) != 0)
+            g_variant_builder_add (&builder, "{sv}", key, value);
+        g_variant_unref (value);
+    }
+
+    g_variant_builder_add (&builder, "{sv}", SIGNON_SESSION_DATA_UI_POLICY,
+                           g_variant_new_int32 (SIGNON_POLICY_NO_USER_INTERACTION));
+    /* The first request can be served by any cached token; the following
+     * ones must obtain a new one */
+    if (token->token != NULL)
+        g_variant_builder_add (&builder, "{sv}",
+                               SIGNON_SESSION_DATA_RENEW_TOKEN,
+                               g_variant_new_boolean (TRUE));
+
+    return g_variant_builder_end (&builder);
+}
+
+static void
+refresh_token_start (RefreshToken *token)
+{
+    SignonTokenRefresher *self = token->refresher;
+
+    DEBUG ("Refreshing token %u", token->token_id);
+
+    self->priv->running++;
+    token->cancellable = g_cancellable_new ();
+    /* Released in refresh_token_process_cb() */
+    g_object_ref (self);
+    signon_auth_session_process_async (token->session,
+                                       refresh_token_build_session_data (token),
+                                       token->mechanism,
+                                       token->cancellable,
+                                       refresh_token_process_cb,
+                                       token);
+}
+
+static void
+refresher_run_due (SignonTokenRefresher *self)
+{
+    SignonTokenRefresherPrivate *priv = self->priv;
+    RefreshToken *token;
+
+    while (priv->running < priv->max_concurrent &&
+           (token = g_queue_pop_head (&priv->due)) != NULL)
+    {
+        token->queued = FALSE;
+        refresh_token_start (token);
+    }
+}
+
+static void
+signon_token_refresher_set_property (GObject *object,
+                                     guint property_id,
+                                     const GValue *value,
+                                     GParamSpec *pspec)
+{
+    SignonTokenRefresher *self = SIGNON_TOKEN_REFRESHER (object);
+    SignonTokenRefresherPrivate *priv = self->priv;
+
+    switch (property_id)
+    {
+    case PROP_CONTEXT:
+        g_assert (priv->context == NULL);
+        priv->context = g_value_dup_object (value);
+        if (priv->context == NULL)
+            priv->context = g_object_ref (signon_context_get_default ());
+        break;
+    case PROP_MAX_CONCURRENT:
+        priv->max_concurrent = g_value_get_uint (value);
+        refresher_run_due (self);
+        break;
+    case PROP_DEFAULT_LIFETIME:
+        priv->default_lifetime = g_value_get_uint (value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+        break;
+    }
+}
+
+static void
+signon_token_refresher_get_property (GObject *object,
+                                     guint property_id,
+                                     GValue *value,
+                                     GParamSpec *pspec)
+{
+    SignonTokenRefresher *self = SIGNON_TOKEN_REFRESHER (object);
+
+    switch (property_id)
+    {
+    case PROP_CONTEXT:
+        g_value_set_object (value, self->priv->context);
+        break;
+    case PROP_MAX_CONCURRENT:
+        g_value_set_uint (value, self->priv->max_concurrent);
+        break;
+    case PROP_DEFAULT_LIFETIME:
+        g_value_set_uint (value, self->priv->default_lifetime);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+        break;
+    }
+}
+
+static void
+signon_token_refresher_init (SignonTokenRefresher *self)
+{
+    SignonTokenRefresherPrivate *priv;
+
+    priv = G_TYPE_INSTANCE_GET_PRIVATE (self, SIGNON_TYPE_TOKEN_REFRESHER,
+                                        SignonTokenRefresherPrivate);
+    self->priv = priv;
+
+    priv->main_context = g_main_context_ref_thread_default ();
+    priv->tokens =
+        g_hash_table_new_full (NULL, NULL, NULL,
+                               (GDestroyNotify) refresh_token_release);
+    g_queue_init (&priv->due);
+}
+
+static void
+signon_token_refresher_dispose (GObject *object)
+{
+    SignonTokenRefresher *self = SIGNON_TOKEN_REFRESHER (object);
+
+    g_hash_table_remove_all (self->priv->tokens);
+
+    G_OBJECT_CLASS (signon_token_refresher_parent_class)->dispose (object);
+}
+
+static void
+signon_token_refresher_finalize (GObject *object)
+{
+    SignonTokenRefresher *self = SIGNON_TOKEN_REFRESHER (object);
+    SignonTokenRefresherPrivate *priv = self->priv;
+
+    g_hash_table_unref (priv->tokens);
+    g_clear_object (&priv->context);
+    g_main_context_unref (priv->main_context);
+
+    G_OBJECT_CLASS (signon_token_refresher_parent_class)->finalize (object);
+}
+
+static void
+signon_token_refresher_class_init (SignonTokenRefresherClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class,
+                              sizeof (SignonTokenRefresherPrivate));
+
+    object_class->set_property = signon_token_refresher_set_property;
+    object_class->get_property = signon_token_refresher_get_property;
+    object_class->dispose = signon_token_refresher_dispose;
+    object_class->finalize = signon_token_refresher_finalize;
+
+    /**
+     * SignonTokenRefresher:context:
+     *
+     * The #SignonContext used to reach signond. If %NULL at construction
+     * time, the default context is used.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_CONTEXT,
+        g_param_spec_object ("context",
+                             "Context",
+                             "Context used to reach the signon daemon",
+                             SIGNON_TYPE_CONTEXT,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+                             G_PARAM_STATIC_STRINGS));
+
+    /**
+     * SignonTokenRefresher:max-concurrent:
+     *
+     * The maximum number of refreshes in progress at the same time; the
+     * other tokens due for a refresh wait for their turn.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_MAX_CONCURRENT,
+        g_param_spec_uint ("max-concurrent",
+                           "Maximum concurrent refreshes",
+                           "Maximum number of refreshes in progress",
+                           1, G_MAXUINT, DEFAULT_MAX_CONCURRENT,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
+                           G_PARAM_STATIC_STRINGS));
+
+    /**
+     * SignonTokenRefresher:default-lifetime:
+     *
+     * The lifetime (in seconds) assumed for the tokens whose reply doesn't
+     * carry an "ExpiresIn" value.
+     *
+     * Since: 1.15
+     */
+    g_object_class_install_property (object_class, PROP_DEFAULT_LIFETIME,
+        g_param_spec_uint ("default-lifetime",
+                           "Default lifetime",
+                           "Lifetime of tokens without an expiration time",
+                           1, G_MAXUINT, DEFAULT_TOKEN_LIFETIME,
+                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
+                           G_PARAM_STATIC_STRINGS));
+
+    /**
+     * SignonTokenRefresher::token-changed:
+     * @refresher: the #SignonTokenRefresher.
+     * @token_id: the id returned by signon_token_refresher_add().
+     *
+     * Emitted when a new token has been obtained.
+     *
+     * Since: 1.15
+     */
+    signals[TOKEN_CHANGED] =
+        g_signal_new ("token-changed",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL,
+                      NULL,
+                      g_cclosure_marshal_VOID__UINT,
+                      G_TYPE_NONE, 1,
+                      G_TYPE_UINT);
+}
+
+/**
+ * signon_token_refresher_new:
+ * @context: (allow-none): a #SignonContext, or %NULL to use the default
+ * context.
+ *
+ * Creates a new #SignonTokenRefresher. Its timers and requests are run in the
+ * thread-default main context of the caller.
+ *
+ * Returns: a new #SignonTokenRefresher.
+ *
+ * Since: 1.15
+ */
+SignonTokenRefresher *
+signon_token_refresher_new (SignonContext *context)
+{
+    g_return_val_if_fail (context == NULL || SIGNON_IS_CONTEXT (context),
+                          NULL);
+
+    return g_object_new (SIGNON_TYPE_TOKEN_REFRESHER,
+                         "context", context,
+                         NULL);
+}
+
+/**
+ * signon_token_refresher_add:
+ * @self: the #SignonTokenRefresher.
+ * @id: the id of the identity, or 0.
+ * @method: the authentication method.
+ * @mechanism: the authentication mechanism.
+ * @session_data: (allow-none): a dictionary of parameters, as for
+ * signon_auth_session_process_async().
+ *
+ * Registers a token to be kept fresh, and starts requesting it. Use
+ * signon_token_refresher_get_token() to read it once the
+ * #SignonTokenRefresher::token-changed signal has been emitted.
+ *
+ * Returns: an id for the token, or 0 if an authentication session could not
+ * be created.
+ *
+ * Since: 1.15
+ */
+guint
+signon_token_refresher_add (SignonTokenRefresher *self,
+                            guint32 id,
+                            const gchar *method,
+                            const gchar *mechanism,
+                            GVariant *session_data)
+{
+    SignonTokenRefresherPrivate *priv;
+    SignonAuthSession *session;
+    RefreshToken *token;
+    GError *error = NULL;
+
+    g_return_val_if_fail (SIGNON_IS_TOKEN_REFRESHER (self), 0);
+    g_return_val_if_fail (method != NULL, 0);
+    g_return_val_if_fail (mechanism != NULL, 0);
+    priv = self->priv;
+
+    session = signon_auth_session_new_full (priv->context, id, method,
+                                            SIGNON_AUTH_SESSION_FLAG_NONE,
+                                            &error);
+    if (G_UNLIKELY (session == NULL))
+    {
+        DEBUG ("Cannot create session: %s", error->message);
+        g_error_free (error);
+        return 0;
+    }
+
+    signon_auth_session_set_priority (session, SIGNON_PRIORITY_BACKGROUND);
+
+    token = g_slice_new0 (RefreshToken);
+    token->refresher = self;
+    token->token_id = ++priv->last_token_id;
+    token->session = session;
+    token->mechanism = g_strdup (mechanism);
+    token->session_data = session_data != NULL ?
+        g_variant_ref_sink (session_data) :
+        g_variant_ref_sink (g_variant_new ("a{sv}", NULL));
+    g_hash_table_insert (priv->tokens, GUINT_TO_POINTER (token->token_id),
+                         token);
+
+    refresh_token_enqueue (token);
+    refresher_run_due (self);
+    return token->token_id;
+}
+
+/**
+ * signon_token_refresher_remove:
+ * @self: the #SignonTokenRefresher.
+ * @token_id: the id returned by signon_token_refresher_add().
+ *
+ * Stops refreshing the token, and cancels its refresh if one is in progress.
+ *
+ * Since: 1.15
+ */
+void
+signon_token_refresher_remove (SignonTokenRefresher *self, guint token_id)
+{
+    g_return_if_fail (SIGNON_IS_TOKEN_REFRESHER (self));
+
+    g_hash_table_remove (self->priv->tokens, GUINT_TO_POINTER (token_id));
+}
+
+/**
+ * signon_token_refresher_get_token:
+ * @self: the #SignonTokenRefresher.
+ * @token_id: the id returned by signon_token_refresher_add().
+ *
+ * Gets the last reply obtained for the token. This never waits for signond.
+ *
+ * Returns: (transfer full): a #GVariant of type %G_VARIANT_TYPE_VARDICT
+ * containing the authentication reply, or %NULL if no token has been
+ * obtained yet or if the last one has expired.
+ *
+ * Since: 1.15
+ */
+GVariant *
+signon_token_refresher_get_token (SignonTokenRefresher *self, guint token_id)
+{
+    RefreshToken *token;
+
+    g_return_val_if_fail (SIGNON_IS_TOKEN_REFRESHER (self), NULL);
+
+    token = g_hash_table_lookup (self->priv->tokens,
+                                 GUINT_TO_POINTER (token_id));
+    if (token == NULL || token->token == NULL ||
+        token->expiry <= g_get_monotonic_time ())
+        return NULL;
+
+    return g_variant_ref (token->token);
+}
@@ -0,0 +1,83 @@
+/* vi: set et sw=4 ts=4 cino=t0,(0: */
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This file is part of libsignon-glib
+ *
+ * Copyright (C) 2018 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef _SIGNON_TOKEN_REFRESHER_H_
+#define _SIGNON_TOKEN_REFRESHER_H_
+
+#include <gio/gio.h>
+#include <glib-object.h>
+#include <libsignon-glib/signon-context.h>
+
+G_BEGIN_DECLS
+
+#define SIGNON_TYPE_TOKEN_REFRESHER             (signon_token_refresher_get_type ())
+#define SIGNON_TOKEN_REFRESHER(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), SIGNON_TYPE_TOKEN_REFRESHER, SignonTokenRefresher))
+#define SIGNON_TOKEN_REFRESHER_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), SIGNON_TYPE_TOKEN_REFRESHER, SignonTokenRefresherClass))
+#define SIGNON_IS_TOKEN_REFRESHER(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SIGNON_TYPE_TOKEN_REFRESHER))
+#define SIGNON_IS_TOKEN_REFRESHER_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), SIGNON_TYPE_TOKEN_REFRESHER))
+#define SIGNON_TOKEN_REFRESHER_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), SIGNON_TYPE_TOKEN_REFRESHER, SignonTokenRefresherClass))
+
+typedef struct _SignonTokenRefresherClass SignonTokenRefresherClass;
+typedef struct _SignonTokenRefresherPrivate SignonTokenRefresherPrivate;
+typedef struct _SignonTokenRefresher SignonTokenRefresher;
+
+/**
+ * SignonTokenRefresherClass:
+ *
+ * Opaque struct. Use the accessor functions below.
+ */
+struct _SignonTokenRefresherClass
+{
+    GObjectClass parent_class;
+};
+
+/**
+ * SignonTokenRefresher:
+ *
+ * Opaque struct. Use the accessor functions below.
+ */
+struct _SignonTokenRefresher
+{
+    GObject parent_instance;
+    SignonTokenRefresherPrivate *priv;
+};
+
+GType signon_token_refresher_get_type (void) G_GNUC_CONST;
+
+SignonTokenRefresher *signon_token_refresher_new (SignonContext *context);
+
+guint signon_token_refresher_add (SignonTokenRefresher *self,
+                                  guint32 id,
+                                  const gchar *method,
+                                  const gchar *mechanism,
+                                  GVariant *session_data);
+void signon_token_refresher_remove (SignonTokenRefresher *self,
+                                    guint token_id);
+
+GVariant *signon_token_refresher_get_token (SignonTokenRefresher *self,
+                                            guint token_id);
+
+G_END_DECLS
+
+#endif /* _SIGNON_TOKEN_REFRESHER_H_ */
@@ -119,3 +119,26 @@ GVariant *signon_hash_table_to_variant (const GHashTable *hash_table)
     }
     return g_variant_builder_end (&builder);
 }
+
+/* Returns the "ExpiresIn" value of @reply, in seconds, or -1 */
+gint64
+signon_reply_get_expires_in (GVariant *reply)
+{
+    GVariant *value;
+    gint64 expires_in = -1;
+
+    value = g_variant_lookup_value (reply, "ExpiresIn", NULL);
+    if (value == NULL) return -1;
+
+    if (g_variant_is_of_type (value, G_VARIANT_TYPE_INT32))
+        expires_in = g_variant_get_int32 (value);
+    else if (g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32))
+        expires_in = g_variant_get_uint32 (value);
+    else if (g_variant_is_of_type (value, G_VARIANT_TYPE_INT64))
+        expires_in = g_variant_get_int64 (value);
+    else if (g_variant_is_of_type (value, G_VARIANT_TYPE_UINT64))
+        expires_in = MIN (g_variant_get_uint64 (value), G_MAXINT64);
+    g_variant_unref (value);
+
+    return expires_in;
+}
@@ -46,4 +46,7 @@ GHashTable *signon_hash_table_from_variant (GVariant *variant);
 G_GNUC_INTERNAL
 GVariant *signon_hash_table_to_variant (const GHashTable *hash_table);
 
+G_GNUC_INTERNAL
+gint64 signon_reply_get_expires_in (GVariant *reply);
+
 #endif //_SIGNON_UTILS_H_
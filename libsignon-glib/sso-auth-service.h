@@ -25,12 +25,21 @@
 #ifndef _SSO_AUTH_SERVICE_H_
 #define _SSO_AUTH_SERVICE_H_
 
+#include "signon-context.h"
 #include "sso-auth-service-gen.h"
 
 G_BEGIN_DECLS
 
+/* Implemented in signon-context.c: the AuthService proxy is owned by the
+ * SignonContext. */
 G_GNUC_INTERNAL
-SsoAuthService *sso_auth_service_get_instance ();
+void sso_auth_service_get_instance_async (SignonContext *context,
+                                          GCancellable *cancellable,
+                                          GAsyncReadyCallback callback,
+                                          gpointer user_data);
+G_GNUC_INTERNAL
+SsoAuthService *sso_auth_service_get_instance_finish (GAsyncResult *res,
+                                                      GError **error);
 
 G_END_DECLS
 
@@ -0,0 +1,149 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This file is part of libsignon-glib
+ *
+ * Copyright (C) 2018 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/*
+ * Measures the throughput of the conversions between SignonIdentityInfo and
+ * its D-Bus representation. The conversion functions are not exported, so
+ * this program is built directly from signon-identity-info.c.
+ *
+ * Usage: benchmark-identity-info [ITERATIONS]
+ */
+
+#include "libsignon-glib/signon-internals.h"
+
+#include <glib.h>
+#include <stdlib.h>
+
+#define DEFAULT_ITERATIONS 100000
+
+typedef void (*BenchmarkFunc) (SignonIdentityInfo *info, GVariant *variant);
+
+static SignonIdentityInfo *
+create_info ()
+{
+    SignonIdentityInfo *info = signon_identity_info_new ();
+    const gchar *mechanisms[] = { "mech1", "mech2", "mech3", NULL };
+    const gchar *realms[] = { "realm1", "realm2", "realm3", NULL };
+    const gchar *acl[] = { "*", "app1", "app2", NULL };
+    gint i;
+
+    signon_identity_info_set_username (info, "James Bond");
+    signon_identity_info_set_secret (info, "007", TRUE);
+    signon_identity_info_set_caption (info, "caption");
+    for (i = 0; i < 8; i++)
+    {
+        gchar *method = g_strdup_printf ("method%d", i);
+        signon_identity_info_set_method (info, method, mechanisms);
+        g_free (method);
+    }
+    signon_identity_info_set_realms (info, realms);
+    signon_identity_info_set_access_control_list (info, acl);
+    signon_identity_info_set_identity_type (info, SIGNON_IDENTITY_TYPE_WEB);
+    return info;
+}
+
+static void
+to_variant_unchanged (SignonIdentityInfo *info, GVariant *variant)
+{
+    g_variant_unref (signon_identity_info_to_variant (info));
+}
+
+static void
+to_variant_modified (SignonIdentityInfo *info, GVariant *variant)
+{
+    signon_identity_info_set_caption (info, "caption");
+    g_variant_unref (signon_identity_info_to_variant (info));
+}
+
+static void
+from_variant_caption (SignonIdentityInfo *info, GVariant *variant)
+{
+    SignonIdentityInfo *decoded;
+
+    decoded = signon_identity_info_new_from_variant (variant);
+    g_assert (signon_identity_info_get_caption (decoded) != NULL);
+    signon_identity_info_free (decoded);
+}
+
+static void
+from_variant_all (SignonIdentityInfo *info, GVariant *variant)
+{
+    SignonIdentityInfo *decoded;
+
+    decoded = signon_identity_info_new_from_variant (variant);
+    g_assert (signon_identity_info_get_username (decoded) != NULL);
+    g_assert (signon_identity_info_get_caption (decoded) != NULL);
+    g_assert (signon_identity_info_get_methods (decoded) != NULL);
+    g_assert (signon_identity_info_get_realms (decoded) != NULL);
+    g_assert (signon_identity_info_get_access_control_list (decoded) != NULL);
+    signon_identity_info_free (decoded);
+}
+
+static void
+run_benchmark (const gchar *name, BenchmarkFunc func,
+               SignonIdentityInfo *info, GVariant *variant, guint iterations)
+{
+    GTimer *timer = g_timer_new ();
+    gdouble elapsed;
+    guint i;
+
+    for (i = 0; i < iterations; i++)
+        func (info, variant);
+
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_print ("%-24s %10.0f ops/s (%u in %.3f s)\n",
+             name, iterations / elapsed, iterations, elapsed);
+    g_timer_destroy (timer);
+}
+
+int
+main (int argc, char *argv[])
+{
+    SignonIdentityInfo *info;
+    GVariant *variant;
+    guint iterations = DEFAULT_ITERATIONS;
+
+    if (argc > 1)
+        iterations = strtoul (argv[1], NULL, 10);
+    if (iterations == 0)
+    {
+        g_printerr ("Usage: %s [ITERATIONS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    info = create_info ();
+    variant = signon_identity_info_to_variant (info);
+
+    run_benchmark ("to_variant (unchanged)", to_variant_unchanged,
+                   info, variant, iterations);
+    run_benchmark ("to_variant (modified)", to_variant_modified,
+                   info, variant, iterations);
+    run_benchmark ("from_variant (caption)", from_variant_caption,
+                   info, variant, iterations);
+    run_benchmark ("from_variant (all)", from_variant_all,
+                   info, variant, iterations);
+
+    g_variant_unref (variant);
+    signon_identity_info_free (info);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,292 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This file is part of libsignon-glib
+ *
+ * Copyright (C) 2018 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+/*
+ * Measures the cost of queueing operations on an object until it becomes
+ * ready, and of dispatching them; for an object which is already ready, it
+ * also compares the latency of the callbacks with the one of the former
+ * dispatching from an idle source. The SignonProxy functions are not
+ * exported, so this program is built directly from signon-proxy.c.
+ *
+ * Usage: benchmark-proxy-ready [OPERATIONS]
+ */
+
+#include "libsignon-glib/signon-internals.h"
+#include "libsignon-glib/signon-proxy.h"
+
+#include <glib.h>
+#include <glib-object.h>
+#include <stdlib.h>
+
+#define DEFAULT_OPERATIONS 10000
+/* D-Bus replies being dispatched, one per main loop iteration */
+#define REPLY_STREAM_LENGTH 8
+
+#define BENCHMARK_TYPE_OBJECT (benchmark_object_get_type ())
+
+typedef struct {
+    GObject parent_instance;
+} BenchmarkObject;
+
+typedef struct {
+    GObjectClass parent_class;
+} BenchmarkObjectClass;
+
+GType benchmark_object_get_type (void);
+static void benchmark_object_proxy_if_init (SignonProxyInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (BenchmarkObject, benchmark_object, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (SIGNON_TYPE_PROXY,
+                                                benchmark_object_proxy_if_init))
+
+static guint completed = 0;
+
+static void
+benchmark_object_proxy_setup (SignonProxy *proxy)
+{
+    /* The benchmark decides when the object becomes ready */
+}
+
+static void
+benchmark_object_proxy_if_init (SignonProxyInterface *iface)
+{
+    iface->setup = benchmark_object_proxy_setup;
+}
+
+static void
+benchmark_object_init (BenchmarkObject *self)
+{
+}
+
+static void
+benchmark_object_class_init (BenchmarkObjectClass *klass)
+{
+}
+
+static GQuark
+benchmark_quark ()
+{
+    return g_quark_from_static_string ("benchmark_ready_quark");
+}
+
+static void
+ready_cb (gpointer object, const GError *error, gpointer user_data)
+{
+    g_assert (error == NULL);
+    completed++;
+}
+
+static void
+wait_completed (guint operations)
+{
+    while (completed < operations)
+        g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+drain_main_context ()
+{
+    while (g_main_context_iteration (NULL, FALSE));
+}
+
+static void
+print_result (const gchar *name, guint operations, gdouble elapsed)
+{
+    g_print ("%-28s %10.0f ops/s (%u in %.3f s)\n",
+             name, operations / elapsed, operations, elapsed);
+}
+
+/* Queue operations while the object is not ready, then make it ready */
+static void
+run_not_ready (guint operations)
+{
+    GObject *object = g_object_new (BENCHMARK_TYPE_OBJECT, NULL);
+    GTimer *timer = g_timer_new ();
+    guint i;
+
+    completed = 0;
+    for (i = 0; i < operations; i++)
+        signon_proxy_call_when_ready (object, benchmark_quark (),
+                                      ready_cb, NULL);
+    print_result ("enqueue (not ready)", operations,
+                  g_timer_elapsed (timer, NULL));
+
+    g_timer_start (timer);
+    signon_proxy_set_ready (object, benchmark_quark (), NULL);
+    g_assert (completed == operations);
+    print_result ("dispatch (set ready)", operations,
+                  g_timer_elapsed (timer, NULL));
+
+    drain_main_context ();
+    g_timer_destroy (timer);
+    g_object_unref (object);
+}
+
+/* Queue a burst of operations on an object which is already ready */
+static void
+run_ready_burst (guint operations)
+{
+    GObject *object = g_object_new (BENCHMARK_TYPE_OBJECT, NULL);
+    GTimer *timer;
+    guint i;
+
+    signon_proxy_set_ready (object, benchmark_quark (), NULL);
+
+    completed = 0;
+    timer = g_timer_new ();
+    for (i = 0; i < operations; i++)
+        signon_proxy_call_when_ready (object, benchmark_quark (),
+                                      ready_cb, NULL);
+    wait_completed (operations);
+    print_result ("enqueue+dispatch (ready)", operations,
+                  g_timer_elapsed (timer, NULL));
+
+    g_timer_destroy (timer);
+    g_object_unref (object);
+}
+
+/* One operation at a time on an object which is already ready, while the
+ * main loop has other idle work pending */
+static gboolean
+busy_idle_cb (gpointer user_data)
+{
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+run_ready_round_trip (guint operations)
+{
+    GObject *object = g_object_new (BENCHMARK_TYPE_OBJECT, NULL);
+    GTimer *timer;
+    guint busy_id;
+    guint i;
+
+    signon_proxy_set_ready (object, benchmark_quark (), NULL);
+    busy_id = g_idle_add (busy_idle_cb, NULL);
+
+    completed = 0;
+    timer = g_timer_new ();
+    for (i = 0; i < operations; i++)
+    {
+        signon_proxy_call_when_ready (object, benchmark_quark (),
+                                      ready_cb, NULL);
+        /* Callbacks are never invoked synchronously */
+        g_assert (completed == i);
+        wait_completed (i + 1);
+    }
+    print_result ("round trip (ready, busy)", operations,
+                  g_timer_elapsed (timer, NULL));
+
+    g_source_remove (busy_id);
+    g_timer_destroy (timer);
+    g_object_unref (object);
+}
+
+/* Each reply in the stream queues the next one, so that they are dispatched
+ * in successive main loop iterations, as when messages keep arriving */
+static gboolean
+reply_cb (gpointer user_data)
+{
+    guint *remaining = user_data;
+
+    if (--(*remaining) > 0)
+        g_idle_add_full (G_PRIORITY_DEFAULT, reply_cb, remaining, NULL);
+    return G_SOURCE_REMOVE;
+}
+
+/* How operations on a ready object were dispatched before: from an idle
+ * source, after all the default priority work */
+static gboolean
+baseline_idle_cb (gpointer user_data)
+{
+    ready_cb (user_data, NULL, NULL);
+    return G_SOURCE_REMOVE;
+}
+
+/* One operation at a time on an object which is already ready, while a
+ * stream of D-Bus replies is being dispatched */
+static void
+run_ready_latency (guint operations, gboolean baseline)
+{
+    GObject *object = g_object_new (BENCHMARK_TYPE_OBJECT, NULL);
+    guint64 iterations = 0;
+    gint64 elapsed = 0;
+    guint replies;
+    guint i;
+
+    signon_proxy_set_ready (object, benchmark_quark (), NULL);
+
+    completed = 0;
+    for (i = 0; i < operations; i++)
+    {
+        gint64 start;
+
+        replies = REPLY_STREAM_LENGTH;
+        g_idle_add_full (G_PRIORITY_DEFAULT, reply_cb, &replies, NULL);
+
+        start = g_get_monotonic_time ();
+        if (baseline)
+            g_idle_add (baseline_idle_cb, object);
+        else
+            signon_proxy_call_when_ready (object, benchmark_quark (),
+                                          ready_cb, NULL);
+        while (completed < i + 1)
+        {
+            g_main_context_iteration (NULL, TRUE);
+            iterations++;
+        }
+        elapsed += g_get_monotonic_time () - start;
+
+        while (replies > 0)
+            g_main_context_iteration (NULL, TRUE);
+    }
+    g_print ("%-28s %10.2f iterations %8.2f us (%u operations)\n",
+             baseline ? "latency (baseline idle)" : "latency (ready)",
+             (gdouble) iterations / operations,
+             (gdouble) elapsed / operations, operations);
+
+    g_object_unref (object);
+}
+
+int
+main (int argc, char *argv[])
+{
+    guint operations = DEFAULT_OPERATIONS;
+
+    if (argc > 1)
+        operations = strtoul (argv[1], NULL, 10);
+    if (operations == 0)
+    {
+        g_printerr ("Usage: %s [OPERATIONS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    run_not_ready (operations);
+    run_ready_burst (operations);
+    run_ready_round_trip (operations);
+    run_ready_latency (operations, TRUE);
+    run_ready_latency (operations, FALSE);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This file is part of libsignon-glib
+ *
+ * Copyright (C) 2018 Canonical Ltd.
+ *
+ * Contact: Alberto Mardegan <alberto.mardegan@canonical.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/*
+ * Measures how long the main loop is blocked while many authentication
+ * sessions set up their remote objects at the same time. A timeout source
+ * which runs at short intervals records the longest gap between two of its
+ * invocations.
+ *
+ * This program talks to signond, so it must run in a D-Bus session where the
+ * daemon can be activated, and the "ssotest" plugin must be installed.
+ *
+ * Usage: benchmark-session-setup [SESSIONS]
+ */
+
+#include "libsignon-glib/signon-auth-session.h"
+
+#include <glib.h>
+#include <stdlib.h>
+
+#define DEFAULT_SESSIONS 50
+#define PROBE_INTERVAL_MS 10
+
+typedef struct {
+    GMainLoop *loop;
+    guint n_pending;
+    guint n_errors;
+    gint64 last_tick;
+    gint64 max_gap;
+    guint n_ticks;
+} Benchmark;
+
+static gboolean
+probe_tick (gpointer user_data)
+{
+    Benchmark *benchmark = user_data;
+    gint64 now = g_get_monotonic_time ();
+
+    benchmark->max_gap = MAX (benchmark->max_gap,
+                              now - benchmark->last_tick);
+    benchmark->last_tick = now;
+    benchmark->n_ticks++;
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+query_mechanisms_cb (SignonAuthSession *self,
+                     gchar **mechanisms,
+                     const GError *error,
+                     gpointer user_data)
+{
+    Benchmark *benchmark = user_data;
+
+    if (error != NULL)
+    {
+        g_printerr ("Query failed: %s\n", error->message);
+        benchmark->n_errors++;
+    }
+    g_strfreev (mechanisms);
+
+    if (--benchmark->n_pending == 0)
+        g_main_loop_quit (benchmark->loop);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const gchar *patterns[] = { "mech1", "mech2", NULL };
+    SignonAuthSession **sessions;
+    Benchmark benchmark = { NULL, 0, 0, 0, 0, 0 };
+    GError *error = NULL;
+    gint64 start;
+    guint n_sessions = DEFAULT_SESSIONS;
+    guint probe_id;
+    guint i;
+
+    if (argc > 1)
+        n_sessions = strtoul (argv[1], NULL, 10);
+    if (n_sessions == 0)
+    {
+        g_printerr ("Usage: %s [SESSIONS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    benchmark.loop = g_main_loop_new (NULL, FALSE);
+    sessions = g_new0 (SignonAuthSession *, n_sessions);
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < n_sessions; i++)
+    {
+        sessions[i] = signon_auth_session_new (0, "ssotest", &error);
+        if (sessions[i] == NULL)
+        {
+            g_printerr ("Cannot create the session: %s\n", error->message);
+            g_clear_error (&error);
+            continue;
+        }
+        benchmark.n_pending++;
+        signon_auth_session_query_available_mechanisms (sessions[i],
+                                                        patterns,
+                                                        query_mechanisms_cb,
+                                                        &benchmark);
+    }
+
+    benchmark.last_tick = g_get_monotonic_time ();
+    probe_id = g_timeout_add (PROBE_INTERVAL_MS, probe_tick, &benchmark);
+    if (benchmark.n_pending > 0)
+        g_main_loop_run (benchmark.loop);
+    g_source_remove (probe_id);
+
+    g_print ("%u sessions ready in %.3f s (%u errors)\n",
+             n_sessions,
+             (g_get_monotonic_time () - start) / (gdouble)G_USEC_PER_SEC,
+             benchmark.n_errors);
+    g_print ("main loop: %u probe ticks, longest gap %.1f ms "
+             "(interval %d ms)\n",
+             benchmark.n_ticks,
+             benchmark.max_gap / (gdouble)G_TIME_SPAN_MILLISECOND,
+             PROBE_INTERVAL_MS);
+
+    for (i = 0; i < n_sessions; i++)
+        if (sessions[i] != NULL)
+            g_object_unref (sessions[i]);
+    g_free (sessions);
+    g_main_loop_unref (benchmark.loop);
+    return benchmark.n_errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
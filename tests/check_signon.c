@@ -34,6 +34,7 @@
 #include "libsignon-glib/signon-auth-session.h"
 #include "libsignon-glib/signon-identity.h"
 #include "libsignon-glib/signon-errors.h"
+#include "libsignon-glib/signon-token-refresher.h"
 
 #include <glib.h>
 #include <check.h>
@@ -158,6 +159,121 @@ START_TEST(test_query_methods)
 }
 END_TEST
 
+static void
+signon_query_methods_count_cb (SignonAuthService *auth_service,
+                               gchar **methods,
+                               const GError *error,
+                               gpointer user_data)
+{
+    gint *counter = user_data;
+
+    fail_unless (error == NULL, "Got error: %s",
+                 error != NULL ? error->message : "");
+    fail_unless (methods != NULL, "The methods does not exist");
+
+    (*counter)--;
+    if (*counter == 0)
+        g_main_loop_quit (main_loop);
+}
+
+START_TEST(test_concurrent_init)
+{
+    SignonAuthService *services[3];
+    SignonIdentity *idty;
+    gint counter = G_N_ELEMENTS (services);
+    guint i;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    /* All these objects are created before the main loop has a chance to
+     * run: they must all share the same pending initialization. */
+    idty = signon_identity_new ();
+    fail_unless (SIGNON_IS_IDENTITY (idty),
+                 "Failed to initialize the Identity.");
+
+    for (i = 0; i < G_N_ELEMENTS (services); i++)
+    {
+        services[i] = signon_auth_service_new ();
+        fail_unless (SIGNON_IS_AUTH_SERVICE (services[i]),
+                     "Failed to initialize the AuthService.");
+        signon_auth_service_query_methods (services[i],
+                                           signon_query_methods_count_cb,
+                                           &counter);
+    }
+
+    g_main_loop_run (main_loop);
+    fail_unless (counter == 0, "Some callbacks were not invoked");
+
+    for (i = 0; i < G_N_ELEMENTS (services); i++)
+        g_object_unref (services[i]);
+    g_object_unref (idty);
+    end_test ();
+}
+END_TEST
+
+static void
+signon_query_methods_thread_cb (SignonAuthService *auth_service,
+                                gchar **methods,
+                                const GError *error,
+                                gpointer user_data)
+{
+    GMainLoop *loop = user_data;
+
+    fail_unless (error == NULL, "Got error: %s",
+                 error != NULL ? error->message : "");
+    fail_unless (methods != NULL, "The methods does not exist");
+    g_main_loop_quit (loop);
+}
+
+static gpointer
+query_methods_in_context_thread (gpointer user_data)
+{
+    GMainContext *context;
+    GMainLoop *loop;
+    SignonAuthService *service;
+
+    context = g_main_context_new ();
+    g_main_context_push_thread_default (context);
+    loop = g_main_loop_new (context, FALSE);
+
+    service = signon_auth_service_new ();
+    fail_unless (SIGNON_IS_AUTH_SERVICE (service),
+                 "Failed to initialize the AuthService.");
+    signon_auth_service_query_methods (service,
+                                       signon_query_methods_thread_cb,
+                                       loop);
+    g_main_loop_run (loop);
+    g_object_unref (service);
+
+    g_main_loop_unref (loop);
+    g_main_context_pop_thread_default (context);
+    g_main_context_unref (context);
+    return NULL;
+}
+
+START_TEST(test_thread_contexts)
+{
+    GThread *threads[4];
+    guint round, i;
+
+    g_debug("%s", G_STRFUNC);
+
+    /* Each thread uses its own main context, which gets destroyed at the end
+     * of the thread: do a few rounds, to make sure that objects created in a
+     * new context never get a stale AuthService proxy. */
+    for (round = 0; round < 3; round++)
+    {
+        for (i = 0; i < G_N_ELEMENTS (threads); i++)
+            threads[i] = g_thread_new ("signon-test",
+                                       query_methods_in_context_thread,
+                                       NULL);
+        for (i = 0; i < G_N_ELEMENTS (threads); i++)
+            g_thread_join (threads[i]);
+    }
+}
+END_TEST
+
 static void
 signon_query_mechanisms_cb (SignonAuthService *auth_service, gchar *method,
         gchar **mechanisms, GError *error, gpointer user_data)
@@ -453,6 +569,233 @@ START_TEST(test_auth_session_creation)
 }
 END_TEST
 
+#define N_CONCURRENT_SESSIONS 50
+
+static void
+test_auth_session_concurrent_setup_cb (SignonAuthSession *self,
+                                       gchar **mechanisms,
+                                       const GError *error,
+                                       gpointer user_data)
+{
+    gint *counter = user_data;
+
+    fail_unless (error == NULL, "Got error: %s",
+                 error != NULL ? error->message : "");
+    fail_unless (mechanisms != NULL, "The mechanisms does not exist");
+    g_strfreev (mechanisms);
+
+    (*counter)--;
+    if (*counter == 0)
+        g_main_loop_quit (main_loop);
+}
+
+START_TEST(test_auth_session_concurrent_setup)
+{
+    SignonAuthSession *sessions[N_CONCURRENT_SESSIONS];
+    gint counter = N_CONCURRENT_SESSIONS;
+    const gchar *patterns[] = { "mech1", "mech2", NULL };
+    GError *err = NULL;
+    guint i;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    for (i = 0; i < N_CONCURRENT_SESSIONS; i++)
+    {
+        sessions[i] = signon_auth_session_new (0, "ssotest", &err);
+        fail_unless (sessions[i] != NULL, "Cannot create AuthSession object");
+        signon_auth_session_query_available_mechanisms (sessions[i],
+                                                        patterns,
+                                                        test_auth_session_concurrent_setup_cb,
+                                                        &counter);
+    }
+
+    g_main_loop_run (main_loop);
+    fail_unless (counter == 0, "Some callbacks were not invoked");
+
+    for (i = 0; i < N_CONCURRENT_SESSIONS; i++)
+        g_object_unref (sessions[i]);
+    g_clear_error (&err);
+    end_test ();
+}
+END_TEST
+
+static gint object_path_calls = 0;
+
+static GDBusMessage *
+count_object_path_filter (GDBusConnection *connection,
+                          GDBusMessage *message,
+                          gboolean incoming,
+                          gpointer user_data)
+{
+    if (!incoming &&
+        g_dbus_message_get_message_type (message) ==
+        G_DBUS_MESSAGE_TYPE_METHOD_CALL &&
+        g_strcmp0 (g_dbus_message_get_member (message),
+                   "getAuthSessionObjectPath") == 0)
+        g_atomic_int_inc (&object_path_calls);
+    return message;
+}
+
+static guint new_identity();
+
+START_TEST(test_auth_session_pool)
+{
+    SignonContext *context;
+    SignonAuthSession *auth_session;
+    GDBusConnection *connection;
+    const gchar *patterns[] = { "mech1", "mech2", NULL };
+    GError *err = NULL;
+    gint counter;
+    guint filter_id;
+    guint id;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    context = signon_context_new (NULL);
+    g_object_set (context, "session-pool-size", 2, NULL);
+    id = new_identity ();
+
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+    fail_unless (connection != NULL);
+    g_atomic_int_set (&object_path_calls, 0);
+    filter_id = g_dbus_connection_add_filter (connection,
+                                              count_object_path_filter,
+                                              NULL, NULL);
+
+    auth_session = signon_auth_session_new_with_context (context, id,
+                                                         "ssotest", &err);
+    fail_unless (auth_session != NULL, "Cannot create AuthSession object");
+    counter = 1;
+    signon_auth_session_query_available_mechanisms (auth_session,
+                                                    patterns,
+                                                    test_auth_session_concurrent_setup_cb,
+                                                    &counter);
+    g_main_loop_run (main_loop);
+    g_object_unref (auth_session);
+    fail_unless (g_atomic_int_get (&object_path_calls) == 1);
+
+    /* The remote object of the previous session is reused */
+    auth_session = signon_auth_session_new_with_context (context, id,
+                                                         "ssotest", &err);
+    counter = 1;
+    signon_auth_session_query_available_mechanisms (auth_session,
+                                                    patterns,
+                                                    test_auth_session_concurrent_setup_cb,
+                                                    &counter);
+    g_main_loop_run (main_loop);
+    g_object_unref (auth_session);
+    fail_unless (g_atomic_int_get (&object_path_calls) == 1,
+                 "Expected 1 call, got %d",
+                 g_atomic_int_get (&object_path_calls));
+
+    g_dbus_connection_remove_filter (connection, filter_id);
+    g_object_unref (connection);
+    g_object_unref (context);
+    g_clear_error (&err);
+    end_test ();
+}
+END_TEST
+
+START_TEST(test_auth_session_pool_no_identity)
+{
+    SignonContext *context;
+    SignonAuthSession *auth_session;
+    GDBusConnection *connection;
+    const gchar *patterns[] = { "mech1", "mech2", NULL };
+    GError *err = NULL;
+    gint counter;
+    guint filter_id;
+    gint i;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    context = signon_context_new (NULL);
+    g_object_set (context, "session-pool-size", 2, NULL);
+
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+    fail_unless (connection != NULL);
+    g_atomic_int_set (&object_path_calls, 0);
+    filter_id = g_dbus_connection_add_filter (connection,
+                                              count_object_path_filter,
+                                              NULL, NULL);
+
+    /* Sessions without an identity might hold the data of an unrelated
+     * user: each one gets its own remote object */
+    for (i = 1; i <= 2; i++)
+    {
+        auth_session = signon_auth_session_new_with_context (context, 0,
+                                                             "ssotest", &err);
+        fail_unless (auth_session != NULL, "Cannot create AuthSession object");
+        counter = 1;
+        signon_auth_session_query_available_mechanisms (auth_session,
+                                                        patterns,
+                                                        test_auth_session_concurrent_setup_cb,
+                                                        &counter);
+        g_main_loop_run (main_loop);
+        g_object_unref (auth_session);
+        fail_unless (g_atomic_int_get (&object_path_calls) == i,
+                     "Expected %d calls, got %d", i,
+                     g_atomic_int_get (&object_path_calls));
+    }
+
+    g_dbus_connection_remove_filter (connection, filter_id);
+    g_object_unref (connection);
+    g_object_unref (context);
+    g_clear_error (&err);
+    end_test ();
+}
+END_TEST
+
+START_TEST(test_auth_session_prefetch)
+{
+    SignonAuthSession *auth_session;
+    GDBusConnection *connection;
+    const gchar *patterns[] = { "mech1", "mech2", NULL };
+    GError *err = NULL;
+    gint counter;
+    guint filter_id;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+    fail_unless (connection != NULL);
+    g_atomic_int_set (&object_path_calls, 0);
+    filter_id = g_dbus_connection_add_filter (connection,
+                                              count_object_path_filter,
+                                              NULL, NULL);
+
+    auth_session =
+        signon_auth_session_new_full (NULL, 0, "ssotest",
+                                      SIGNON_AUTH_SESSION_FLAG_PREFETCH,
+                                      &err);
+    fail_unless (auth_session != NULL, "Cannot create AuthSession object");
+
+    /* The remote session is requested before any operation is made */
+    while (g_atomic_int_get (&object_path_calls) == 0)
+        g_main_context_iteration (NULL, TRUE);
+
+    counter = 1;
+    signon_auth_session_query_available_mechanisms (auth_session,
+                                                    patterns,
+                                                    test_auth_session_concurrent_setup_cb,
+                                                    &counter);
+    g_main_loop_run (main_loop);
+    fail_unless (g_atomic_int_get (&object_path_calls) == 1,
+                 "Expected 1 call, got %d",
+                 g_atomic_int_get (&object_path_calls));
+
+    g_dbus_connection_remove_filter (connection, filter_id);
+    g_object_unref (auth_session);
+    g_object_unref (connection);
+    g_clear_error (&err);
+    end_test ();
+}
+END_TEST
+
 START_TEST(test_auth_session_process)
 {
     gint state_counter = 0;
@@ -623,118 +966,710 @@ START_TEST(test_auth_session_process_async)
 }
 END_TEST
 
-static void
-test_auth_session_process_failure_cb (GObject *source_object,
-                                      GAsyncResult *res,
-                                      gpointer user_data)
-{
-    SignonAuthSession *auth_session = SIGNON_AUTH_SESSION (source_object);
-    GVariant *v_reply;
-    GError **error = user_data;
+static gint process_calls = 0;
 
-    fail_unless (SIGNON_IS_AUTH_SESSION (source_object));
+static GDBusMessage *
+count_process_filter (GDBusConnection *connection,
+                      GDBusMessage *message,
+                      gboolean incoming,
+                      gpointer user_data)
+{
+    if (!incoming &&
+        g_dbus_message_get_message_type (message) ==
+        G_DBUS_MESSAGE_TYPE_METHOD_CALL &&
+        g_strcmp0 (g_dbus_message_get_member (message), "process") == 0)
+        g_atomic_int_inc (&process_calls);
+    return message;
+}
 
-    v_reply = signon_auth_session_process_finish (auth_session, res, error);
-    fail_unless (v_reply == NULL);
+static GVariant *
+token_cache_session_data (gboolean renew_token, guint32 window_id)
+{
+    GVariantBuilder builder;
 
-    g_main_loop_quit (main_loop);
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add (&builder, "{sv}",
+                           SIGNON_SESSION_DATA_USERNAME,
+                           g_variant_new_string ("test_username"));
+    g_variant_builder_add (&builder, "{sv}",
+                           SIGNON_SESSION_DATA_SECRET,
+                           g_variant_new_string ("test_pw"));
+    g_variant_builder_add (&builder, "{sv}",
+                           SIGNON_SESSION_DATA_RENEW_TOKEN,
+                           g_variant_new_boolean (renew_token));
+    g_variant_builder_add (&builder, "{sv}",
+                           SIGNON_SESSION_DATA_WINDOW_ID,
+                           g_variant_new_uint32 (window_id));
+    return g_variant_builder_end (&builder);
 }
 
-START_TEST(test_auth_session_process_failure)
+START_TEST(test_auth_session_token_cache)
 {
+    SignonContext *context;
     SignonAuthSession *auth_session;
-    GVariantBuilder builder;
-    GVariant *session_data;
-    GError *error = NULL;
+    GDBusConnection *connection;
+    GVariant *reply, *cached_reply;
+    GError *err = NULL;
+    guint filter_id;
 
     g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
 
-    auth_session = signon_auth_session_new (0, "nonexisting-method", &error);
-    fail_unless (auth_session != NULL, "Cannot create AuthSession object");
-    fail_unless (error == NULL);
+    context = signon_context_new (NULL);
+    g_object_set (context, "token-cache-ttl", 60, NULL);
 
-    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
-    g_variant_builder_add (&builder, "{sv}",
-                           "key", g_variant_new_string ("value"));
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+    fail_unless (connection != NULL);
+    g_atomic_int_set (&process_calls, 0);
+    filter_id = g_dbus_connection_add_filter (connection,
+                                              count_process_filter,
+                                              NULL, NULL);
 
-    session_data = g_variant_builder_end (&builder);
+    auth_session = signon_auth_session_new_with_context (context, 0,
+                                                         "ssotest", &err);
+    fail_unless (auth_session != NULL, "Cannot create AuthSession object");
 
     signon_auth_session_process_async (auth_session,
-                                       session_data,
-                                       "mech1",
-                                       NULL,
-                                       test_auth_session_process_failure_cb,
-                                       &error);
+                                       token_cache_session_data (FALSE, 1),
+                                       "mech1", NULL,
+                                       test_auth_session_process_async_cb,
+                                       &reply);
+    g_main_loop_run (main_loop);
+    fail_unless (reply != NULL);
+    fail_unless (g_atomic_int_get (&process_calls) == 1);
 
-    main_loop = g_main_loop_new (NULL, FALSE);
+    /* The same request, from another window, is served from the cache */
+    signon_auth_session_process_async (auth_session,
+                                       token_cache_session_data (FALSE, 2),
+                                       "mech1", NULL,
+                                       test_auth_session_process_async_cb,
+                                       &cached_reply);
     g_main_loop_run (main_loop);
-    fail_unless (error != NULL);
-    fail_unless (error->domain == SIGNON_ERROR);
-    fail_unless (error->code == SIGNON_ERROR_METHOD_NOT_KNOWN);
+    fail_unless (cached_reply != NULL);
+    fail_unless (g_variant_equal (reply, cached_reply));
+    fail_unless (g_atomic_int_get (&process_calls) == 1,
+                 "Expected 1 call, got %d",
+                 g_atomic_int_get (&process_calls));
+    g_variant_unref (cached_reply);
+
+    /* Unless a new token is requested */
+    signon_auth_session_process_async (auth_session,
+                                       token_cache_session_data (TRUE, 1),
+                                       "mech1", NULL,
+                                       test_auth_session_process_async_cb,
+                                       &cached_reply);
+    g_main_loop_run (main_loop);
+    fail_unless (cached_reply != NULL);
+    fail_unless (g_atomic_int_get (&process_calls) == 2,
+                 "Expected 2 calls, got %d",
+                 g_atomic_int_get (&process_calls));
+    g_variant_unref (cached_reply);
 
-    g_error_free (error);
+    g_dbus_connection_remove_filter (connection, filter_id);
+    g_variant_unref (reply);
     g_object_unref (auth_session);
-
+    g_object_unref (connection);
+    g_object_unref (context);
+    g_clear_error (&err);
     end_test ();
 }
 END_TEST
 
 static void
-test_auth_session_process_after_store_cb (SignonAuthSession *self,
-                                          GHashTable *reply,
-                                          const GError *error,
-                                          gpointer user_data)
+test_auth_session_dedup_cb (GObject *source_object,
+                            GAsyncResult *res,
+                            gpointer user_data)
 {
-    GValue *v_username;
+    GVariant **replies = user_data;
+    GError *error = NULL;
+    gint i;
 
-    if (error != NULL)
-    {
-        fail("Got error: %s", error->message);
-        g_main_loop_quit (main_loop);
-        return;
-    }
+    for (i = 0; replies[i] != NULL; i++);
+    replies[i] =
+        signon_auth_session_process_finish (SIGNON_AUTH_SESSION (source_object),
+                                            res, &error);
+    fail_unless (error == NULL);
+    fail_unless (replies[i] != NULL);
 
-    fail_unless (reply != NULL, "The result is empty");
+    if (i == 1)
+        g_main_loop_quit (main_loop);
+}
 
-    v_username = g_hash_table_lookup(reply,
-                                     SIGNON_SESSION_DATA_USERNAME);
+START_TEST(test_auth_session_deduplicate)
+{
+    SignonAuthSession *session1, *session2;
+    GDBusConnection *connection;
+    GVariant *replies[3] = { NULL, NULL, NULL };
+    GError *err = NULL;
+    guint filter_id;
 
-    fail_unless (g_strcmp0 (g_value_get_string (v_username), "Nice user") == 0,
-                 "Wrong value of username");
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
 
-    g_object_unref (self);
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+    fail_unless (connection != NULL);
+    g_atomic_int_set (&process_calls, 0);
+    filter_id = g_dbus_connection_add_filter (connection,
+                                              count_process_filter,
+                                              NULL, NULL);
+
+    session1 = signon_auth_session_new_full (NULL, 0, "ssotest",
+                                             SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE,
+                                             &err);
+    fail_unless (session1 != NULL, "Cannot create AuthSession object");
+    session2 = signon_auth_session_new_full (NULL, 0, "ssotest",
+                                             SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE,
+                                             &err);
+    fail_unless (session2 != NULL, "Cannot create AuthSession object");
+
+    /* Identical requests, differing only in the window, share one call */
+    signon_auth_session_process_async (session1,
+                                       token_cache_session_data (FALSE, 1),
+                                       "mech1", NULL,
+                                       test_auth_session_dedup_cb, replies);
+    signon_auth_session_process_async (session2,
+                                       token_cache_session_data (FALSE, 2),
+                                       "mech1", NULL,
+                                       test_auth_session_dedup_cb, replies);
+    g_main_loop_run (main_loop);
 
-    g_main_loop_quit (main_loop);
+    fail_unless (g_atomic_int_get (&process_calls) == 1,
+                 "Expected 1 call, got %d",
+                 g_atomic_int_get (&process_calls));
+    fail_unless (g_variant_equal (replies[0], replies[1]));
+
+    g_dbus_connection_remove_filter (connection, filter_id);
+    g_variant_unref (replies[0]);
+    g_variant_unref (replies[1]);
+    g_object_unref (session1);
+    g_object_unref (session2);
+    g_object_unref (connection);
+    end_test ();
 }
+END_TEST
+
+typedef struct {
+    SignonAuthSession *session;
+    gint order;
+} QueuedRequest;
+
+static gint completed_requests = 0;
+static gint expected_requests = 0;
 
 static void
-test_auth_session_process_after_store_start_session(SignonIdentity *self,
-                                                    guint32 id,
-                                                    const GError *error,
-                                                    gpointer user_data)
+test_auth_session_queue_cb (GObject *source_object,
+                            GAsyncResult *res,
+                            gpointer user_data)
 {
-    GError *err = NULL;
+    QueuedRequest *request = user_data;
+    GVariant *reply;
+    GError *error = NULL;
 
-    if (error != NULL)
-    {
-        g_warning ("%s %d: %s", G_STRFUNC, __LINE__, error->message);
-        fail();
+    fail_unless ((gpointer)source_object == (gpointer)request->session);
+    reply = signon_auth_session_process_finish (request->session, res, &error);
+    fail_unless (error == NULL);
+    fail_unless (reply != NULL);
+    g_variant_unref (reply);
+
+    request->order = ++completed_requests;
+    if (completed_requests == expected_requests)
         g_main_loop_quit (main_loop);
-        return;
-    }
+}
 
-    fail_unless (id > 0);
+START_TEST(test_auth_session_queue)
+{
+    SignonContext *context;
+    SignonAuthSession *session1, *session2;
+    QueuedRequest requests[4];
+    GError *err = NULL;
+    gint i;
 
-    SignonAuthSession *auth_session =
-        signon_identity_create_session (self,
-                                        "ssotest",
-                                        &err);
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
 
-    fail_unless (auth_session != NULL, "Cannot create AuthSession object");
-    if (err != NULL)
+    context = signon_context_new (NULL);
+    g_object_set (context, "max-in-flight", 1, NULL);
+
+    session1 = signon_auth_session_new_with_context (context, 0, "ssotest",
+                                                     &err);
+    fail_unless (session1 != NULL, "Cannot create AuthSession object");
+    session2 = signon_auth_session_new_with_context (context, 0, "ssotest",
+                                                     &err);
+    fail_unless (session2 != NULL, "Cannot create AuthSession object");
+
+    completed_requests = 0;
+    expected_requests = 4;
+    requests[0].session = session1;
+    requests[1].session = session1;
+    requests[2].session = session2;
+    requests[3].session = session2;
+    for (i = 0; i < 4; i++)
     {
-        fail ("Got error: %s", err->message);
-        g_clear_error (&err);
+        requests[i].order = 0;
+        signon_auth_session_process_async (requests[i].session,
+                                           token_cache_session_data (FALSE, i),
+                                           "mech1", NULL,
+                                           test_auth_session_queue_cb,
+                                           &requests[i]);
+    }
+
+    /* Only the first request is sent right away */
+    fail_unless (signon_auth_session_get_queue_depth (session1) == 1);
+    fail_unless (signon_auth_session_get_queue_depth (session2) == 2);
+    fail_unless (signon_context_get_queue_depth (context) == 3);
+
+    g_main_loop_run (main_loop);
+
+    /* Each session handles its requests in order */
+    fail_unless (requests[0].order < requests[1].order);
+    fail_unless (requests[2].order < requests[3].order);
+    fail_unless (signon_auth_session_get_queue_depth (session1) == 0);
+    fail_unless (signon_auth_session_get_queue_depth (session2) == 0);
+    fail_unless (signon_context_get_queue_depth (context) == 0);
+
+    g_object_unref (session1);
+    g_object_unref (session2);
+    g_object_unref (context);
+    end_test ();
+}
+END_TEST
+
+START_TEST(test_auth_session_priority)
+{
+    SignonContext *context;
+    SignonAuthSession *sessions[3];
+    QueuedRequest requests[3];
+    GError *err = NULL;
+    gint i;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    context = signon_context_new (NULL);
+    g_object_set (context, "max-in-flight", 1, NULL);
+
+    for (i = 0; i < 3; i++)
+    {
+        sessions[i] = signon_auth_session_new_with_context (context, 0,
+                                                            "ssotest", &err);
+        fail_unless (sessions[i] != NULL, "Cannot create AuthSession object");
+    }
+    fail_unless (signon_auth_session_get_priority (sessions[0]) ==
+                 SIGNON_PRIORITY_DEFAULT);
+    signon_auth_session_set_priority (sessions[1], SIGNON_PRIORITY_BACKGROUND);
+    signon_auth_session_set_priority (sessions[2], SIGNON_PRIORITY_INTERACTIVE);
+
+    completed_requests = 0;
+    expected_requests = 3;
+    for (i = 0; i < 3; i++)
+    {
+        requests[i].session = sessions[i];
+        requests[i].order = 0;
+        signon_auth_session_process_async (sessions[i],
+                                           token_cache_session_data (FALSE, i),
+                                           "mech1", NULL,
+                                           test_auth_session_queue_cb,
+                                           &requests[i]);
+    }
+    fail_unless (signon_context_get_queue_depth (context) == 2);
+
+    g_main_loop_run (main_loop);
+
+    /* The interactive request overtakes the background one */
+    fail_unless (requests[0].order == 1);
+    fail_unless (requests[2].order == 2);
+    fail_unless (requests[1].order == 3);
+
+    for (i = 0; i < 3; i++)
+        g_object_unref (sessions[i]);
+    g_object_unref (context);
+    end_test ();
+}
+END_TEST
+
+static void
+test_auth_session_timeout_cb (GObject *source_object,
+                              GAsyncResult *res,
+                              gpointer user_data)
+{
+    GError **error = user_data;
+    GVariant *reply;
+
+    reply = signon_auth_session_process_finish (SIGNON_AUTH_SESSION (source_object),
+                                                res, error);
+    if (reply != NULL)
+        g_variant_unref (reply);
+
+    g_main_loop_quit (main_loop);
+}
+
+START_TEST(test_auth_session_timeout)
+{
+    SignonAuthSession *auth_session;
+    GError *error = NULL;
+    guint timeout;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    auth_session = signon_auth_session_new (0, "ssotest", &error);
+    fail_unless (auth_session != NULL, "Cannot create AuthSession object");
+
+    g_object_set (auth_session, "timeout", 1, NULL);
+    g_object_get (auth_session, "timeout", &timeout, NULL);
+    fail_unless (timeout == 1);
+
+    /* The request expires before it can be sent */
+    signon_auth_session_process_async (auth_session,
+                                       token_cache_session_data (FALSE, 0),
+                                       "mech1", NULL,
+                                       test_auth_session_timeout_cb, &error);
+    g_usleep (10000);
+    g_main_loop_run (main_loop);
+    fail_unless (g_error_matches (error, SIGNON_ERROR,
+                                  SIGNON_ERROR_TIMED_OUT),
+                 "Expected a timeout error");
+    g_clear_error (&error);
+
+    /* The session is still usable */
+    g_object_set (auth_session, "timeout", 0, NULL);
+    signon_auth_session_process_async (auth_session,
+                                       token_cache_session_data (FALSE, 0),
+                                       "mech1", NULL,
+                                       test_auth_session_timeout_cb, &error);
+    g_main_loop_run (main_loop);
+    fail_unless (error == NULL);
+
+    g_object_unref (auth_session);
+    end_test ();
+}
+END_TEST
+
+typedef struct {
+    gint order;
+    GError *error;
+} WaitingRequest;
+
+static void
+test_auth_session_waiting_cb (GObject *source_object,
+                              GAsyncResult *res,
+                              gpointer user_data)
+{
+    WaitingRequest *request = user_data;
+    GVariant *reply;
+
+    reply = signon_auth_session_process_finish (SIGNON_AUTH_SESSION (source_object),
+                                                res, &request->error);
+    if (reply != NULL)
+        g_variant_unref (reply);
+
+    request->order = ++completed_requests;
+    if (completed_requests == expected_requests)
+        g_main_loop_quit (main_loop);
+}
+
+START_TEST(test_auth_session_cancel_waiting)
+{
+    SignonContext *context;
+    SignonAuthSession *session1, *session2, *session3;
+    WaitingRequest requests[3] = { { 0, NULL }, { 0, NULL }, { 0, NULL } };
+    GCancellable *cancellable;
+    GError *err = NULL;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    context = signon_context_new (NULL);
+    g_object_set (context, "max-in-flight", 1, NULL);
+
+    session1 = signon_auth_session_new_full (context, 0, "ssotest",
+                                             SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE,
+                                             &err);
+    fail_unless (session1 != NULL, "Cannot create AuthSession object");
+    session2 = signon_auth_session_new_full (context, 0, "ssotest",
+                                             SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE,
+                                             &err);
+    fail_unless (session2 != NULL, "Cannot create AuthSession object");
+    session3 = signon_auth_session_new_with_context (context, 0, "ssotest",
+                                                     &err);
+    fail_unless (session3 != NULL, "Cannot create AuthSession object");
+    cancellable = g_cancellable_new ();
+
+    completed_requests = 0;
+    expected_requests = 3;
+    /* The first request is sent, the second one waits for its reply and
+     * the third one is queued */
+    signon_auth_session_process_async (session1,
+                                       token_cache_session_data (FALSE, 0),
+                                       "mech1", NULL,
+                                       test_auth_session_waiting_cb,
+                                       &requests[0]);
+    signon_auth_session_process_async (session2,
+                                       token_cache_session_data (FALSE, 0),
+                                       "mech1", cancellable,
+                                       test_auth_session_waiting_cb,
+                                       &requests[1]);
+    signon_auth_session_process_async (session3,
+                                       token_cache_session_data (FALSE, 1),
+                                       "mech1", cancellable,
+                                       test_auth_session_waiting_cb,
+                                       &requests[2]);
+    fail_unless (signon_context_get_queue_depth (context) == 1);
+
+    /* The waiting requests fail right away, without waiting for the first
+     * one to complete */
+    g_cancellable_cancel (cancellable);
+    g_main_loop_run (main_loop);
+
+    fail_unless (g_error_matches (requests[1].error, G_IO_ERROR,
+                                  G_IO_ERROR_CANCELLED),
+                 "Expected a cancellation error");
+    fail_unless (g_error_matches (requests[2].error, G_IO_ERROR,
+                                  G_IO_ERROR_CANCELLED),
+                 "Expected a cancellation error");
+    fail_unless (requests[0].error == NULL);
+    fail_unless (requests[0].order == 3);
+    fail_unless (signon_auth_session_get_queue_depth (session3) == 0);
+    fail_unless (signon_context_get_queue_depth (context) == 0);
+
+    g_clear_error (&requests[1].error);
+    g_clear_error (&requests[2].error);
+    g_object_unref (cancellable);
+    g_object_unref (session1);
+    g_object_unref (session2);
+    g_object_unref (session3);
+    g_object_unref (context);
+    end_test ();
+}
+END_TEST
+
+START_TEST(test_auth_session_timeout_shared)
+{
+    SignonAuthSession *session1, *session2;
+    WaitingRequest requests[2] = { { 0, NULL }, { 0, NULL } };
+    GError *err = NULL;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    session1 = signon_auth_session_new_full (NULL, 0, "ssotest",
+                                             SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE,
+                                             &err);
+    fail_unless (session1 != NULL, "Cannot create AuthSession object");
+    session2 = signon_auth_session_new_full (NULL, 0, "ssotest",
+                                             SIGNON_AUTH_SESSION_FLAG_DEDUPLICATE,
+                                             &err);
+    fail_unless (session2 != NULL, "Cannot create AuthSession object");
+    g_object_set (session2, "timeout", 1, NULL);
+
+    completed_requests = 0;
+    expected_requests = 2;
+    /* The second request joins the first one, which has no deadline */
+    signon_auth_session_process_async (session1,
+                                       token_cache_session_data (FALSE, 0),
+                                       "mech1", NULL,
+                                       test_auth_session_waiting_cb,
+                                       &requests[0]);
+    signon_auth_session_process_async (session2,
+                                       token_cache_session_data (FALSE, 0),
+                                       "mech1", NULL,
+                                       test_auth_session_waiting_cb,
+                                       &requests[1]);
+    g_usleep (10000);
+    g_main_loop_run (main_loop);
+
+    /* Only the joined request expires */
+    fail_unless (g_error_matches (requests[1].error, SIGNON_ERROR,
+                                  SIGNON_ERROR_TIMED_OUT),
+                 "Expected a timeout error");
+    fail_unless (requests[1].order == 1);
+    fail_unless (requests[0].error == NULL);
+    fail_unless (requests[0].order == 2);
+
+    g_clear_error (&requests[1].error);
+    g_object_unref (session1);
+    g_object_unref (session2);
+    end_test ();
+}
+END_TEST
+
+static void
+token_changed_cb (SignonTokenRefresher *refresher, guint token_id,
+                  gpointer user_data)
+{
+    gint *changes = user_data;
+
+    (*changes)++;
+    if (*changes == 2)
+        g_main_loop_quit (main_loop);
+}
+
+START_TEST(test_token_refresher)
+{
+    SignonTokenRefresher *refresher;
+    GVariantBuilder builder;
+    GVariant *token;
+    gchar *username = NULL;
+    gint changes = 0;
+    guint token_id;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    refresher = signon_token_refresher_new (NULL);
+    fail_unless (SIGNON_IS_TOKEN_REFRESHER (refresher));
+    /* The test plugin doesn't report an expiration time */
+    g_object_set (refresher, "default-lifetime", 1, NULL);
+    g_signal_connect (refresher, "token-changed",
+                      G_CALLBACK (token_changed_cb), &changes);
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add (&builder, "{sv}",
+                           SIGNON_SESSION_DATA_USERNAME,
+                           g_variant_new_string ("test_username"));
+    g_variant_builder_add (&builder, "{sv}",
+                           SIGNON_SESSION_DATA_SECRET,
+                           g_variant_new_string ("test_pw"));
+    token_id = signon_token_refresher_add (refresher, 0, "ssotest", "mech1",
+                                           g_variant_builder_end (&builder));
+    fail_unless (token_id != 0);
+
+    /* No token is available until the first reply arrives */
+    fail_unless (signon_token_refresher_get_token (refresher, token_id) == NULL);
+    fail_unless (signon_token_refresher_get_token (refresher,
+                                                   token_id + 1) == NULL);
+
+    /* The token is obtained, and then refreshed before it expires */
+    g_main_loop_run (main_loop);
+    fail_unless (changes == 2);
+
+    token = signon_token_refresher_get_token (refresher, token_id);
+    fail_unless (token != NULL);
+    g_variant_lookup (token, SIGNON_SESSION_DATA_USERNAME, "s", &username);
+    ck_assert_str_eq (username, "test_username");
+    g_free (username);
+    g_variant_unref (token);
+
+    signon_token_refresher_remove (refresher, token_id);
+    fail_unless (signon_token_refresher_get_token (refresher, token_id) == NULL);
+
+    g_object_unref (refresher);
+    end_test ();
+}
+END_TEST
+
+static void
+test_auth_session_process_failure_cb (GObject *source_object,
+                                      GAsyncResult *res,
+                                      gpointer user_data)
+{
+    SignonAuthSession *auth_session = SIGNON_AUTH_SESSION (source_object);
+    GVariant *v_reply;
+    GError **error = user_data;
+
+    fail_unless (SIGNON_IS_AUTH_SESSION (source_object));
+
+    v_reply = signon_auth_session_process_finish (auth_session, res, error);
+    fail_unless (v_reply == NULL);
+
+    g_main_loop_quit (main_loop);
+}
+
+START_TEST(test_auth_session_process_failure)
+{
+    SignonAuthSession *auth_session;
+    GVariantBuilder builder;
+    GVariant *session_data;
+    GError *error = NULL;
+
+    g_debug("%s", G_STRFUNC);
+
+    auth_session = signon_auth_session_new (0, "nonexisting-method", &error);
+    fail_unless (auth_session != NULL, "Cannot create AuthSession object");
+    fail_unless (error == NULL);
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add (&builder, "{sv}",
+                           "key", g_variant_new_string ("value"));
+
+    session_data = g_variant_builder_end (&builder);
+
+    signon_auth_session_process_async (auth_session,
+                                       session_data,
+                                       "mech1",
+                                       NULL,
+                                       test_auth_session_process_failure_cb,
+                                       &error);
+
+    main_loop = g_main_loop_new (NULL, FALSE);
+    g_main_loop_run (main_loop);
+    fail_unless (error != NULL);
+    fail_unless (error->domain == SIGNON_ERROR);
+    fail_unless (error->code == SIGNON_ERROR_METHOD_NOT_KNOWN);
+
+    g_error_free (error);
+    g_object_unref (auth_session);
+
+    end_test ();
+}
+END_TEST
+
+static void
+test_auth_session_process_after_store_cb (SignonAuthSession *self,
+                                          GHashTable *reply,
+                                          const GError *error,
+                                          gpointer user_data)
+{
+    GValue *v_username;
+
+    if (error != NULL)
+    {
+        fail("Got error: %s", error->message);
+        g_main_loop_quit (main_loop);
+        return;
+    }
+
+    fail_unless (reply != NULL, "The result is empty");
+
+    v_username = g_hash_table_lookup(reply,
+                                     SIGNON_SESSION_DATA_USERNAME);
+
+    fail_unless (g_strcmp0 (g_value_get_string (v_username), "Nice user") == 0,
+                 "Wrong value of username");
+
+    g_object_unref (self);
+
+    g_main_loop_quit (main_loop);
+}
+
+static void
+test_auth_session_process_after_store_start_session(SignonIdentity *self,
+                                                    guint32 id,
+                                                    const GError *error,
+                                                    gpointer user_data)
+{
+    GError *err = NULL;
+
+    if (error != NULL)
+    {
+        g_warning ("%s %d: %s", G_STRFUNC, __LINE__, error->message);
+        fail();
+        g_main_loop_quit (main_loop);
+        return;
+    }
+
+    fail_unless (id > 0);
+
+    SignonAuthSession *auth_session =
+        signon_identity_create_session (self,
+                                        "ssotest",
+                                        &err);
+
+    fail_unless (auth_session != NULL, "Cannot create AuthSession object");
+    if (err != NULL)
+    {
+        fail ("Got error: %s", err->message);
+        g_clear_error (&err);
     }
 
     GHashTable *session_data = g_hash_table_new (g_str_hash,
@@ -843,11 +1778,589 @@ new_identity()
                                                  &id);
     g_hash_table_destroy (methods);
 
-    if (id == 0)
-        g_main_loop_run (main_loop);
+    if (id == 0)
+        g_main_loop_run (main_loop);
+
+    return id;
+
+}
+
+static void
+context_identity_info_cb (SignonIdentity *self,
+                          const SignonIdentityInfo *info,
+                          const GError *error,
+                          gpointer user_data)
+{
+    fail_unless (error == NULL, "Got error: %s",
+                 error != NULL ? error->message : "");
+    fail_unless (info != NULL, "No info");
+    fail_unless (g_strcmp0 (signon_identity_info_get_caption (info),
+                            "caption") == 0, "Wrong caption");
+    g_main_loop_quit (main_loop);
+}
+
+START_TEST(test_context)
+{
+    GDBusConnection *connection;
+    SignonContext *context;
+    SignonContext *session_context = NULL;
+    SignonAuthService *service;
+    SignonAuthSession *session;
+    SignonIdentity *idty;
+    GError *error = NULL;
+    gint counter = 1;
+    guint id;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    id = new_identity ();
+    fail_unless (id != 0);
+
+    /* Reuse an already open connection */
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+    fail_unless (connection != NULL, "Got error: %s",
+                 error != NULL ? error->message : "");
+
+    context = signon_context_new (connection);
+    fail_unless (SIGNON_IS_CONTEXT (context));
+    fail_unless (context != signon_context_get_default ());
+    fail_unless (signon_context_get_connection (context) == connection);
+
+    service = signon_auth_service_new_with_context (context);
+    fail_unless (SIGNON_IS_AUTH_SERVICE (service));
+    signon_auth_service_query_methods (service,
+                                       signon_query_methods_count_cb,
+                                       &counter);
+    g_main_loop_run (main_loop);
+    fail_unless (counter == 0, "The callback was not invoked");
+
+    idty = signon_identity_new_from_db_with_context (context, id);
+    fail_unless (SIGNON_IS_IDENTITY (idty));
+    signon_identity_query_info (idty, context_identity_info_cb, NULL);
+    g_main_loop_run (main_loop);
+
+    /* Sessions inherit the context of their identity */
+    session = signon_identity_create_session (idty, "ssotest", &error);
+    fail_unless (session != NULL, "Cannot create AuthSession object");
+    g_object_get (session, "context", &session_context, NULL);
+    fail_unless (session_context == context);
+    g_object_unref (session_context);
+
+    g_object_unref (session);
+    g_object_unref (idty);
+    g_object_unref (service);
+    g_object_unref (context);
+    g_object_unref (connection);
+    end_test ();
+}
+END_TEST
+
+static GVariant *
+identity_info_test_variant ()
+{
+    const gchar *mechanisms[] = { "mech1", "mech2", NULL };
+    const gchar *realms[] = { "realm1", "realm2", NULL };
+    const gchar *acl[] = { "*", NULL };
+    GVariantBuilder builder, methods;
+
+    g_variant_builder_init (&methods, G_VARIANT_TYPE ("a{sas}"));
+    g_variant_builder_add (&methods, "{s^as}", "method1", mechanisms);
+    g_variant_builder_add (&methods, "{s^as}", "method2", mechanisms);
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add (&builder, "{sv}", SIGNOND_IDENTITY_INFO_ID,
+                           g_variant_new_uint32 (42));
+    g_variant_builder_add (&builder, "{sv}", SIGNOND_IDENTITY_INFO_USERNAME,
+                           g_variant_new_string ("James Bond"));
+    g_variant_builder_add (&builder, "{sv}", SIGNOND_IDENTITY_INFO_SECRET,
+                           g_variant_new_string ("007"));
+    g_variant_builder_add (&builder, "{sv}",
+                           SIGNOND_IDENTITY_INFO_STORESECRET,
+                           g_variant_new_boolean (TRUE));
+    g_variant_builder_add (&builder, "{sv}", SIGNOND_IDENTITY_INFO_CAPTION,
+                           g_variant_new_string ("caption"));
+    g_variant_builder_add (&builder, "{sv}",
+                           SIGNOND_IDENTITY_INFO_AUTHMETHODS,
+                           g_variant_builder_end (&methods));
+    g_variant_builder_add (&builder, "{sv}", SIGNOND_IDENTITY_INFO_REALMS,
+                           g_variant_new_strv (realms, -1));
+    g_variant_builder_add (&builder, "{sv}", SIGNOND_IDENTITY_INFO_ACL,
+                           g_variant_new_strv (acl, -1));
+    g_variant_builder_add (&builder, "{sv}", SIGNOND_IDENTITY_INFO_TYPE,
+                           g_variant_new_uint32 (SIGNON_IDENTITY_TYPE_WEB));
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/* A minimal stand-in for signond, serving the AuthService interface on a
+ * peer-to-peer connection */
+static const gchar stand_in_introspection[] =
+    "<node>"
+    "  <interface name='com.google.code.AccountsSSO.SingleSignOn.AuthService'>"
+    "    <method name='queryMethods'>"
+    "      <arg type='as' name='methods' direction='out'/>"
+    "    </method>"
+    "    <method name='queryIdentities'>"
+    "      <arg type='a{sv}' name='filter' direction='in'/>"
+    "      <arg type='aa{sv}' name='identities' direction='out'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>";
+
+static guint stand_in_query_methods_calls = 0;
+
+#define STAND_IN_N_IDENTITIES 10000
+
+static void
+stand_in_method_call (GDBusConnection *connection,
+                      const gchar *sender,
+                      const gchar *object_path,
+                      const gchar *interface_name,
+                      const gchar *method_name,
+                      GVariant *parameters,
+                      GDBusMethodInvocation *invocation,
+                      gpointer user_data)
+{
+    const gchar *methods[] = { "stand-in", NULL };
+
+    if (g_strcmp0 (method_name, "queryMethods") == 0)
+    {
+        stand_in_query_methods_calls++;
+        g_dbus_method_invocation_return_value (invocation,
+                                               g_variant_new ("(^as)",
+                                                              methods));
+    }
+    else if (g_strcmp0 (method_name, "queryIdentities") == 0)
+    {
+        GVariantBuilder builder;
+        GVariant *filter;
+        guint i;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+
+        /* Filtering by id returns a single, complete identity */
+        filter = g_variant_get_child_value (parameters, 0);
+        if (g_variant_lookup (filter, SIGNOND_IDENTITY_INFO_ID, "u", NULL))
+        {
+            GVariant *info = identity_info_test_variant ();
+
+            g_variant_builder_add_value (&builder, info);
+            g_variant_unref (info);
+            g_variant_unref (filter);
+            g_dbus_method_invocation_return_value (invocation,
+                                                   g_variant_new ("(aa{sv})",
+                                                                  &builder));
+            return;
+        }
+        g_variant_unref (filter);
+
+        for (i = 1; i <= STAND_IN_N_IDENTITIES; i++)
+        {
+            gchar *caption = g_strdup_printf ("Identity %u", i);
+
+            g_variant_builder_open (&builder, G_VARIANT_TYPE_VARDICT);
+            g_variant_builder_add (&builder, "{sv}", SIGNOND_IDENTITY_INFO_ID,
+                                   g_variant_new_uint32 (i));
+            g_variant_builder_add (&builder, "{sv}",
+                                   SIGNOND_IDENTITY_INFO_CAPTION,
+                                   g_variant_new_string (caption));
+            g_variant_builder_close (&builder);
+            g_free (caption);
+        }
+        g_dbus_method_invocation_return_value (invocation,
+                                               g_variant_new ("(aa{sv})",
+                                                              &builder));
+    }
+    else
+        g_dbus_method_invocation_return_dbus_error (invocation,
+                                                    "org.freedesktop.DBus.Error.UnknownMethod",
+                                                    method_name);
+}
+
+static const GDBusInterfaceVTable stand_in_vtable = {
+    stand_in_method_call,
+    NULL,
+    NULL,
+};
+
+static gboolean
+stand_in_new_connection_cb (GDBusServer *server,
+                            GDBusConnection *connection,
+                            gpointer user_data)
+{
+    GDBusNodeInfo *node_info = user_data;
+    GError *error = NULL;
+
+    g_dbus_connection_register_object (connection,
+                                       SIGNOND_DAEMON_OBJECTPATH,
+                                       node_info->interfaces[0],
+                                       &stand_in_vtable,
+                                       NULL, NULL, &error);
+    fail_unless (error == NULL, "Cannot register object: %s",
+                 error != NULL ? error->message : "");
+
+    /* Keep the connection alive until the end of the test */
+    g_object_set_data_full (G_OBJECT (server), "connection",
+                            g_object_ref (connection), g_object_unref);
+    return TRUE;
+}
+
+static void
+signon_query_methods_stand_in_cb (SignonAuthService *auth_service,
+                                  gchar **methods,
+                                  const GError *error,
+                                  gpointer user_data)
+{
+    gboolean expected = GPOINTER_TO_INT (user_data);
+
+    fail_unless (error == NULL, "Got error: %s",
+                 error != NULL ? error->message : "");
+    fail_unless (methods != NULL, "The methods does not exist");
+    fail_unless (_contains (methods, "stand-in") == expected,
+                 "The request went to the wrong server");
+    g_main_loop_quit (main_loop);
+}
+
+static GDBusServer *
+stand_in_server_new ()
+{
+    GDBusNodeInfo *node_info;
+    GDBusServer *server;
+    gchar *guid;
+    GError *error = NULL;
+
+    node_info = g_dbus_node_info_new_for_xml (stand_in_introspection, &error);
+    fail_unless (node_info != NULL);
+
+    guid = g_dbus_generate_guid ();
+    server = g_dbus_server_new_sync ("unix:tmpdir=/tmp",
+                                     G_DBUS_SERVER_FLAGS_NONE,
+                                     guid, NULL, NULL, &error);
+    fail_unless (server != NULL, "Cannot create server: %s",
+                 error != NULL ? error->message : "");
+    g_free (guid);
+
+    g_object_set_data_full (G_OBJECT (server), "node-info", node_info,
+                            (GDestroyNotify) g_dbus_node_info_unref);
+    g_signal_connect (server, "new-connection",
+                      G_CALLBACK (stand_in_new_connection_cb), node_info);
+    g_dbus_server_start (server);
+    stand_in_query_methods_calls = 0;
+    return server;
+}
+
+START_TEST(test_context_peer_to_peer)
+{
+    GDBusServer *server;
+    SignonContext *context;
+    SignonAuthService *service;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    server = stand_in_server_new ();
+
+    /* The requests must reach the stand-in server */
+    context =
+        signon_context_new_for_address (g_dbus_server_get_client_address (server));
+    service = signon_auth_service_new_with_context (context);
+    signon_auth_service_query_methods (service,
+                                       signon_query_methods_stand_in_cb,
+                                       GINT_TO_POINTER (TRUE));
+    g_main_loop_run (main_loop);
+    fail_unless (signon_context_get_connection (context) != NULL);
+    fail_unless (g_dbus_connection_get_unique_name (signon_context_get_connection (context)) == NULL,
+                 "Not a peer-to-peer connection");
+    g_object_unref (service);
+    g_object_unref (context);
+
+    /* If the address is not reachable, the session bus is used */
+    context = signon_context_new_for_address ("unix:path=/nonexistent/signond");
+    service = signon_auth_service_new_with_context (context);
+    signon_auth_service_query_methods (service,
+                                       signon_query_methods_stand_in_cb,
+                                       GINT_TO_POINTER (FALSE));
+    g_main_loop_run (main_loop);
+    fail_unless (g_dbus_connection_get_unique_name (signon_context_get_connection (context)) != NULL,
+                 "Not a bus connection");
+    g_object_unref (service);
+    g_object_unref (context);
+
+    g_dbus_server_stop (server);
+    g_object_unref (server);
+    end_test ();
+}
+END_TEST
+
+START_TEST(test_query_cache)
+{
+    GDBusServer *server;
+    SignonContext *context;
+    SignonAuthService *services[3];
+    gint counter;
+    guint i;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    server = stand_in_server_new ();
+    context =
+        signon_context_new_for_address (g_dbus_server_get_client_address (server));
+
+    /* Concurrent requests share a single D-Bus call */
+    counter = G_N_ELEMENTS (services);
+    for (i = 0; i < G_N_ELEMENTS (services); i++)
+    {
+        services[i] = signon_auth_service_new_with_context (context);
+        signon_auth_service_query_methods (services[i],
+                                           signon_query_methods_count_cb,
+                                           &counter);
+    }
+    g_main_loop_run (main_loop);
+    fail_unless (counter == 0, "Some callbacks were not invoked");
+    fail_unless (stand_in_query_methods_calls == 1,
+                 "Expected 1 call, got %u", stand_in_query_methods_calls);
+
+    /* Later requests are served from the cache */
+    counter = 1;
+    signon_auth_service_query_methods (services[0],
+                                       signon_query_methods_count_cb,
+                                       &counter);
+    g_main_loop_run (main_loop);
+    fail_unless (stand_in_query_methods_calls == 1,
+                 "Expected 1 call, got %u", stand_in_query_methods_calls);
+
+    /* Disabling the cache */
+    g_object_set (context, "query-cache-ttl", 0, NULL);
+    counter = 1;
+    signon_auth_service_query_methods (services[0],
+                                       signon_query_methods_count_cb,
+                                       &counter);
+    g_main_loop_run (main_loop);
+    fail_unless (stand_in_query_methods_calls == 2,
+                 "Expected 2 calls, got %u", stand_in_query_methods_calls);
+
+    for (i = 0; i < G_N_ELEMENTS (services); i++)
+        g_object_unref (services[i]);
+    g_object_unref (context);
+    g_dbus_server_stop (server);
+    g_object_unref (server);
+    end_test ();
+}
+END_TEST
+
+static gint query_methods_calls = 0;
+
+static GDBusMessage *
+count_query_methods_filter (GDBusConnection *connection,
+                            GDBusMessage *message,
+                            gboolean incoming,
+                            gpointer user_data)
+{
+    if (!incoming &&
+        g_dbus_message_get_message_type (message) ==
+        G_DBUS_MESSAGE_TYPE_METHOD_CALL &&
+        g_strcmp0 (g_dbus_message_get_member (message), "queryMethods") == 0)
+        g_atomic_int_inc (&query_methods_calls);
+    return message;
+}
+
+START_TEST(test_query_cache_default_context)
+{
+    GDBusConnection *connection;
+    SignonAuthService *service;
+    SignonIdentity *idty;
+    gint counter;
+    guint filter_id;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+    fail_unless (connection != NULL);
+    g_atomic_int_set (&query_methods_calls, 0);
+    filter_id = g_dbus_connection_add_filter (connection,
+                                              count_query_methods_filter,
+                                              NULL, NULL);
+
+    g_object_set (signon_context_get_default (), "query-cache-ttl", 60, NULL);
+
+    /* The identity keeps the connection to signond in use */
+    idty = signon_identity_new ();
+    fail_unless (SIGNON_IS_IDENTITY (idty));
+
+    /* The first reply is cached, even though it's the one which caused
+     * the proxy to be created */
+    service = signon_auth_service_new ();
+    counter = 1;
+    signon_auth_service_query_methods (service,
+                                       signon_query_methods_count_cb,
+                                       &counter);
+    g_main_loop_run (main_loop);
+    g_object_unref (service);
+    fail_unless (g_atomic_int_get (&query_methods_calls) == 1,
+                 "Expected 1 call, got %d",
+                 g_atomic_int_get (&query_methods_calls));
+
+    /* It survives the objects which made the request */
+    service = signon_auth_service_new ();
+    counter = 1;
+    signon_auth_service_query_methods (service,
+                                       signon_query_methods_count_cb,
+                                       &counter);
+    g_main_loop_run (main_loop);
+    g_object_unref (service);
+    fail_unless (g_atomic_int_get (&query_methods_calls) == 1,
+                 "Expected 1 call, got %d",
+                 g_atomic_int_get (&query_methods_calls));
+
+    g_dbus_connection_remove_filter (connection, filter_id);
+    g_object_unref (idty);
+    g_object_unref (connection);
+    end_test ();
+}
+END_TEST
+
+START_TEST(test_default_context_finalized)
+{
+    GMainContext *main_context;
+    SignonContext *context;
+    SignonAuthService *service;
+    gint counter = 1;
+
+    g_debug("%s", G_STRFUNC);
+    main_context = g_main_context_new ();
+    g_main_context_push_thread_default (main_context);
+    main_loop = g_main_loop_new (main_context, FALSE);
+
+    context = signon_context_get_default ();
+    fail_unless (SIGNON_IS_CONTEXT (context));
+    g_object_add_weak_pointer ((GObject *)context, (gpointer *)&context);
+
+    /* Fill the query cache, which is enabled by default */
+    service = signon_auth_service_new ();
+    signon_auth_service_query_methods (service,
+                                       signon_query_methods_count_cb,
+                                       &counter);
+    g_main_loop_run (main_loop);
+    g_object_unref (service);
+
+    /* Let GDBus release what it holds in the main context */
+    while (g_main_context_iteration (main_context, FALSE));
+
+    g_main_context_pop_thread_default (main_context);
+    g_main_loop_unref (main_loop);
+    main_loop = NULL;
+    g_main_context_unref (main_context);
+
+    fail_unless (context == NULL, "The default context was not finalized");
+    end_test ();
+}
+END_TEST
+
+static void
+query_identities_cb (GObject *source_object,
+                     GAsyncResult *res,
+                     gpointer user_data)
+{
+    SignonIdentityInfoIter **iter = user_data;
+    GError *error = NULL;
+
+    *iter = signon_auth_service_query_identities_finish (
+        SIGNON_AUTH_SERVICE (source_object), res, &error);
+    fail_unless (error == NULL, "Got error: %s",
+                 error != NULL ? error->message : "");
+    g_main_loop_quit (main_loop);
+}
+
+START_TEST(test_query_identities)
+{
+    GDBusServer *server;
+    SignonContext *context;
+    SignonAuthService *service;
+    SignonIdentityInfoIter *iter = NULL;
+    SignonIdentityInfo *info;
+    guint n_items = 0;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    server = stand_in_server_new ();
+    context =
+        signon_context_new_for_address (g_dbus_server_get_client_address (server));
+    service = signon_auth_service_new_with_context (context);
+
+    signon_auth_service_query_identities_async (service, NULL, NULL,
+                                                query_identities_cb, &iter);
+    g_main_loop_run (main_loop);
 
-    return id;
+    fail_unless (iter != NULL);
+    fail_unless (signon_identity_info_iter_get_n_items (iter) ==
+                 STAND_IN_N_IDENTITIES);
+
+    while ((info = signon_identity_info_iter_next (iter)) != NULL)
+    {
+        gchar *caption;
+
+        n_items++;
+        fail_unless (signon_identity_info_get_id (info) == (gint)n_items);
+        caption = g_strdup_printf ("Identity %u", n_items);
+        fail_unless (g_strcmp0 (signon_identity_info_get_caption (info),
+                                caption) == 0);
+        g_free (caption);
+        signon_identity_info_free (info);
+    }
+    fail_unless (n_items == STAND_IN_N_IDENTITIES,
+                 "Expected %u identities, got %u",
+                 STAND_IN_N_IDENTITIES, n_items);
+    fail_unless (signon_identity_info_iter_next (iter) == NULL);
+
+    signon_identity_info_iter_unref (iter);
+    g_object_unref (service);
+    g_object_unref (context);
+    g_dbus_server_stop (server);
+    g_object_unref (server);
+    end_test ();
+}
+END_TEST
+
+/* Gets the complete identity from the stand-in server, the way a client
+ * would receive it from signond */
+static SignonIdentityInfo *
+stand_in_get_identity_info ()
+{
+    GDBusServer *server;
+    SignonContext *context;
+    SignonAuthService *service;
+    SignonIdentityInfoIter *iter = NULL;
+    SignonIdentityInfo *info;
+    GVariantBuilder filter;
+
+    server = stand_in_server_new ();
+    context =
+        signon_context_new_for_address (g_dbus_server_get_client_address (server));
+    service = signon_auth_service_new_with_context (context);
+
+    g_variant_builder_init (&filter, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add (&filter, "{sv}", SIGNOND_IDENTITY_INFO_ID,
+                           g_variant_new_uint32 (42));
+    signon_auth_service_query_identities_async (service,
+                                                g_variant_builder_end (&filter),
+                                                NULL,
+                                                query_identities_cb, &iter);
+    g_main_loop_run (main_loop);
 
+    fail_unless (iter != NULL);
+    fail_unless (signon_identity_info_iter_get_n_items (iter) == 1);
+    info = signon_identity_info_iter_next (iter);
+    fail_unless (info != NULL);
+
+    signon_identity_info_iter_unref (iter);
+    g_object_unref (service);
+    g_object_unref (context);
+    g_dbus_server_stop (server);
+    g_object_unref (server);
+    return info;
 }
 
 static gboolean
@@ -1263,6 +2776,489 @@ START_TEST(test_info_identity)
 }
 END_TEST
 
+#define N_CONCURRENT_QUERIES 100
+
+static gint get_info_calls = 0;
+
+static GDBusMessage *
+count_get_info_filter (GDBusConnection *connection,
+                       GDBusMessage *message,
+                       gboolean incoming,
+                       gpointer user_data)
+{
+    if (!incoming &&
+        g_dbus_message_get_message_type (message) ==
+        G_DBUS_MESSAGE_TYPE_METHOD_CALL &&
+        g_strcmp0 (g_dbus_message_get_member (message), "getInfo") == 0)
+        g_atomic_int_inc (&get_info_calls);
+    return message;
+}
+
+static void
+identity_info_count_cb (SignonIdentity *self,
+                        const SignonIdentityInfo *info,
+                        const GError *error,
+                        gpointer user_data)
+{
+    gint *counter = user_data;
+
+    fail_unless (error == NULL, "Got error: %s",
+                 error != NULL ? error->message : "");
+    fail_unless (info != NULL, "No info");
+    fail_unless (g_strcmp0 (signon_identity_info_get_caption (info),
+                            "caption") == 0, "Wrong caption");
+
+    (*counter)--;
+    if (*counter == 0)
+        g_main_loop_quit (main_loop);
+}
+
+START_TEST(test_info_identity_single_flight)
+{
+    const gchar *const acl[] = { "*", NULL };
+    GDBusConnection *connection;
+    SignonContext *context;
+    SignonIdentity *idty2;
+    GHashTable *methods;
+    gint counter;
+    guint filter_id;
+    guint id;
+    gint i;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    SignonIdentity *idty = signon_identity_new();
+    fail_unless (SIGNON_IS_IDENTITY (idty),
+                 "Failed to initialize the Identity.");
+
+    methods = create_methods_hashtable();
+    signon_identity_store_credentials_with_args (idty,
+                                                 "James Bond",
+                                                 "007",
+                                                 1,
+                                                 methods,
+                                                 "caption",
+                                                 NULL,
+                                                 acl,
+                                                 0,
+                                                 store_credentials_identity_cb,
+                                                 NULL);
+    g_main_loop_run (main_loop);
+
+    /* A separate context doesn't share the info stored by idty */
+    g_object_get (idty, "id", &id, NULL);
+    fail_unless (id != 0);
+    context = signon_context_new (NULL);
+    idty2 = signon_identity_new_from_db_with_context (context, id);
+    counter = 1;
+    signon_identity_query_info (idty2, identity_info_count_cb, &counter);
+    g_main_loop_run (main_loop);
+
+    /* Storing the identity again makes signond notify idty2 that its info
+     * is outdated */
+    signon_identity_store_credentials_with_args (idty,
+                                                 "James Bond",
+                                                 "007",
+                                                 1,
+                                                 methods,
+                                                 "caption",
+                                                 NULL,
+                                                 acl,
+                                                 0,
+                                                 store_credentials_identity_cb,
+                                                 NULL);
+    g_hash_table_destroy (methods);
+    g_main_loop_run (main_loop);
+
+    /* All the contexts use the shared session bus connection */
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+    fail_unless (connection != NULL);
+    g_atomic_int_set (&get_info_calls, 0);
+    filter_id = g_dbus_connection_add_filter (connection,
+                                              count_get_info_filter,
+                                              NULL, NULL);
+
+    counter = N_CONCURRENT_QUERIES;
+    for (i = 0; i < N_CONCURRENT_QUERIES; i++)
+        signon_identity_query_info (idty2, identity_info_count_cb, &counter);
+    g_main_loop_run (main_loop);
+
+    g_dbus_connection_remove_filter (connection, filter_id);
+    fail_unless (counter == 0, "Some callbacks were not invoked");
+    fail_unless (g_atomic_int_get (&get_info_calls) == 1,
+                 "Expected 1 GetInfo call, got %d",
+                 g_atomic_int_get (&get_info_calls));
+
+    g_object_unref (connection);
+    g_object_unref (idty2);
+    g_object_unref (context);
+    g_object_unref (idty);
+    end_test ();
+}
+END_TEST
+
+START_TEST(test_info_identity_shared)
+{
+    const gchar *const acl[] = { "*", NULL };
+    GDBusConnection *connection;
+    SignonIdentity *idty2;
+    GHashTable *methods;
+    gint counter;
+    guint filter_id;
+    guint id;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    SignonIdentity *idty = signon_identity_new();
+    fail_unless (SIGNON_IS_IDENTITY (idty),
+                 "Failed to initialize the Identity.");
+
+    methods = create_methods_hashtable();
+    signon_identity_store_credentials_with_args (idty,
+                                                 "James Bond",
+                                                 "007",
+                                                 1,
+                                                 methods,
+                                                 "caption",
+                                                 NULL,
+                                                 acl,
+                                                 0,
+                                                 store_credentials_identity_cb,
+                                                 NULL);
+    g_hash_table_destroy (methods);
+    g_main_loop_run (main_loop);
+
+    /* The info of idty is the one just stored */
+    g_object_get (idty, "id", &id, NULL);
+    fail_unless (id != 0);
+
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+    fail_unless (connection != NULL);
+    g_atomic_int_set (&get_info_calls, 0);
+    filter_id = g_dbus_connection_add_filter (connection,
+                                              count_get_info_filter,
+                                              NULL, NULL);
+
+    /* idty2 shares the info of idty */
+    idty2 = signon_identity_new_from_db (id);
+    counter = 1;
+    signon_identity_query_info (idty2, identity_info_count_cb, &counter);
+    g_main_loop_run (main_loop);
+
+    counter = 1;
+    signon_identity_query_info (idty, identity_info_count_cb, &counter);
+    g_main_loop_run (main_loop);
+
+    g_dbus_connection_remove_filter (connection, filter_id);
+    fail_unless (g_atomic_int_get (&get_info_calls) == 0,
+                 "Expected no GetInfo calls, got %d",
+                 g_atomic_int_get (&get_info_calls));
+
+    g_object_unref (connection);
+    g_object_unref (idty2);
+    g_object_unref (idty);
+    end_test ();
+}
+END_TEST
+
+START_TEST(test_info_identity_write_through)
+{
+    const gchar *const acl[] = { "*", NULL };
+    GDBusConnection *connection;
+    GHashTable *methods;
+    gint counter;
+    guint filter_id;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    SignonIdentity *idty = signon_identity_new();
+    fail_unless (SIGNON_IS_IDENTITY (idty),
+                 "Failed to initialize the Identity.");
+
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+    fail_unless (connection != NULL);
+    g_atomic_int_set (&get_info_calls, 0);
+    filter_id = g_dbus_connection_add_filter (connection,
+                                              count_get_info_filter,
+                                              NULL, NULL);
+
+    methods = create_methods_hashtable();
+    signon_identity_store_credentials_with_args (idty,
+                                                 "James Bond",
+                                                 "007",
+                                                 1,
+                                                 methods,
+                                                 "caption",
+                                                 NULL,
+                                                 acl,
+                                                 0,
+                                                 store_credentials_identity_cb,
+                                                 NULL);
+    g_hash_table_destroy (methods);
+    g_main_loop_run (main_loop);
+
+    /* The stored info is known already */
+    counter = 1;
+    signon_identity_query_info (idty, identity_info_count_cb, &counter);
+    g_main_loop_run (main_loop);
+
+    g_dbus_connection_remove_filter (connection, filter_id);
+    fail_unless (g_atomic_int_get (&get_info_calls) == 0,
+                 "Expected no GetInfo calls, got %d",
+                 g_atomic_int_get (&get_info_calls));
+
+    g_object_unref (connection);
+    g_object_unref (idty);
+    end_test ();
+}
+END_TEST
+
+START_TEST(test_identity_interned)
+{
+    const gchar *const acl[] = { "*", NULL };
+    SignonIdentity *idty1, *idty2, *idty3;
+    GHashTable *methods;
+    gint counter;
+    guint id;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    SignonIdentity *idty = signon_identity_new();
+    fail_unless (SIGNON_IS_IDENTITY (idty),
+                 "Failed to initialize the Identity.");
+
+    methods = create_methods_hashtable();
+    signon_identity_store_credentials_with_args (idty,
+                                                 "James Bond",
+                                                 "007",
+                                                 1,
+                                                 methods,
+                                                 "caption",
+                                                 NULL,
+                                                 acl,
+                                                 0,
+                                                 store_credentials_identity_cb,
+                                                 NULL);
+    g_hash_table_destroy (methods);
+    g_main_loop_run (main_loop);
+
+    g_object_get (idty, "id", &id, NULL);
+    fail_unless (id != 0);
+
+    idty1 = signon_identity_get_from_db (NULL, id);
+    fail_unless (SIGNON_IS_IDENTITY (idty1));
+    idty2 = signon_identity_get_from_db (signon_context_get_default (), id);
+    fail_unless (idty2 == idty1, "Interned identity not reused");
+    idty3 = signon_identity_new_from_db (id);
+    fail_unless (idty3 != idty1, "Non-interned identity was reused");
+
+    counter = 1;
+    signon_identity_query_info (idty2, identity_info_count_cb, &counter);
+    g_main_loop_run (main_loop);
+
+    g_object_unref (idty1);
+    g_object_unref (idty2);
+    g_object_unref (idty3);
+
+    /* A different context has its own instances */
+    SignonContext *context = signon_context_new (NULL);
+    idty1 = signon_identity_get_from_db (context, id);
+    idty2 = signon_identity_get_from_db (NULL, id);
+    fail_unless (idty1 != idty2);
+    g_object_unref (idty1);
+    g_object_unref (idty2);
+    g_object_unref (context);
+
+    g_object_unref (idty);
+    end_test ();
+}
+END_TEST
+
+static void
+identity_new_from_db_many_cb (GObject *source_object,
+                              GAsyncResult *res,
+                              gpointer user_data)
+{
+    GPtrArray **identities = user_data;
+    GError *error = NULL;
+
+    *identities = signon_identity_new_from_db_many_finish (res, &error);
+    fail_unless (error == NULL, "Got error: %s",
+                 error != NULL ? error->message : "");
+    g_main_loop_quit (main_loop);
+}
+
+START_TEST(test_identity_new_from_db_many)
+{
+    const gchar *const acl[] = { "*", NULL };
+    GPtrArray *identities = NULL;
+    GHashTable *methods;
+    guint32 ids[101];
+    gint counter;
+    guint id, i;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    SignonIdentity *idty = signon_identity_new();
+    fail_unless (SIGNON_IS_IDENTITY (idty),
+                 "Failed to initialize the Identity.");
+
+    methods = create_methods_hashtable();
+    signon_identity_store_credentials_with_args (idty,
+                                                 "James Bond",
+                                                 "007",
+                                                 1,
+                                                 methods,
+                                                 "caption",
+                                                 NULL,
+                                                 acl,
+                                                 0,
+                                                 store_credentials_identity_cb,
+                                                 NULL);
+    g_hash_table_destroy (methods);
+    g_main_loop_run (main_loop);
+
+    g_object_get (idty, "id", &id, NULL);
+    fail_unless (id != 0);
+
+    /* More identities than are loaded in parallel, and a missing one */
+    for (i = 0; i < 100; i++)
+        ids[i] = id;
+    ids[100] = G_MAXUINT32;
+
+    signon_identity_new_from_db_many (NULL, ids, G_N_ELEMENTS (ids), NULL,
+                                      identity_new_from_db_many_cb,
+                                      &identities);
+    g_main_loop_run (main_loop);
+
+    fail_unless (identities != NULL);
+    fail_unless (identities->len == G_N_ELEMENTS (ids));
+    for (i = 0; i < 100; i++)
+    {
+        SignonIdentity *loaded = g_ptr_array_index (identities, i);
+        fail_unless (SIGNON_IS_IDENTITY (loaded));
+        fail_unless (signon_identity_get_last_error (loaded) == NULL,
+                     "Identity %u not loaded", i);
+    }
+    fail_unless (signon_identity_get_last_error (
+        g_ptr_array_index (identities, 100)) != NULL,
+        "Missing identity loaded");
+
+    /* The info came with the identities */
+    counter = 1;
+    signon_identity_query_info (g_ptr_array_index (identities, 0),
+                                identity_info_count_cb, &counter);
+    g_main_loop_run (main_loop);
+
+    g_ptr_array_unref (identities);
+    g_object_unref (idty);
+    end_test ();
+}
+END_TEST
+
+START_TEST(test_identity_info_from_variant)
+{
+    const gchar *realms[] = { "other-realm", NULL };
+    SignonIdentityInfo *info, *copy;
+    const GHashTable *methods;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    /* The D-Bus reply is gone by now: the strings must still be valid */
+    info = stand_in_get_identity_info ();
+
+    fail_unless (signon_identity_info_get_id (info) == 42);
+    fail_unless (g_strcmp0 (signon_identity_info_get_caption (info),
+                            "caption") == 0);
+    fail_unless (g_strcmp0 (signon_identity_info_get_username (info),
+                            "James Bond") == 0);
+    fail_unless (signon_identity_info_get_storing_secret (info) == TRUE);
+    fail_unless (signon_identity_info_get_identity_type (info) ==
+                 SIGNON_IDENTITY_TYPE_WEB);
+
+    methods = signon_identity_info_get_methods (info);
+    fail_unless (g_hash_table_size ((GHashTable *)methods) == 2);
+    fail_unless (_contains (g_hash_table_lookup ((GHashTable *)methods,
+                                                 "method2"), "mech2"));
+    fail_unless (_contains ((gchar **)signon_identity_info_get_realms (info),
+                            "realm2"));
+    fail_unless (_contains ((gchar **)
+                            signon_identity_info_get_access_control_list (info),
+                            "*"));
+
+    /* Setters override the decoded values */
+    signon_identity_info_set_caption (info, NULL);
+    fail_unless (signon_identity_info_get_caption (info) == NULL);
+    signon_identity_info_set_realms (info, realms);
+    fail_unless (!_contains ((gchar **)signon_identity_info_get_realms (info),
+                             "realm2"));
+    signon_identity_info_remove_method (info, "method1");
+
+    copy = signon_identity_info_copy (info);
+    fail_unless (g_strcmp0 (signon_identity_info_get_username (copy),
+                            "James Bond") == 0);
+    fail_unless (signon_identity_info_get_caption (copy) == NULL);
+    fail_unless (g_hash_table_size ((GHashTable *)
+                                    signon_identity_info_get_methods (copy)) == 1);
+    signon_identity_info_free (copy);
+
+    signon_identity_info_free (info);
+    end_test ();
+}
+END_TEST
+
+START_TEST(test_identity_info_copy_on_write)
+{
+    const gchar *mechanisms[] = { "mech3", NULL };
+    SignonIdentityInfo *info, *copy, *copy2;
+
+    g_debug("%s", G_STRFUNC);
+    main_loop = g_main_loop_new (NULL, FALSE);
+
+    info = stand_in_get_identity_info ();
+
+    /* Copies share the data */
+    copy = signon_identity_info_copy (info);
+    fail_unless (signon_identity_info_get_caption (copy) ==
+                 signon_identity_info_get_caption (info));
+    fail_unless (signon_identity_info_get_methods (copy) ==
+                 signon_identity_info_get_methods (info));
+
+    /* Until one of them is modified */
+    signon_identity_info_set_caption (copy, "new caption");
+    signon_identity_info_set_method (copy, "method3", mechanisms);
+    fail_unless (g_strcmp0 (signon_identity_info_get_caption (copy),
+                            "new caption") == 0);
+    fail_unless (g_strcmp0 (signon_identity_info_get_caption (info),
+                            "caption") == 0);
+    fail_unless (g_hash_table_size ((GHashTable *)
+                                    signon_identity_info_get_methods (copy)) == 3);
+    fail_unless (g_hash_table_size ((GHashTable *)
+                                    signon_identity_info_get_methods (info)) == 2);
+    fail_unless (g_strcmp0 (signon_identity_info_get_username (copy),
+                            "James Bond") == 0);
+
+    /* Modifying the original does not affect its copies either */
+    copy2 = signon_identity_info_copy (info);
+    signon_identity_info_set_username (info, "Felix Leiter");
+    fail_unless (g_strcmp0 (signon_identity_info_get_username (copy2),
+                            "James Bond") == 0);
+    signon_identity_info_free (info);
+    fail_unless (g_strcmp0 (signon_identity_info_get_caption (copy2),
+                            "caption") == 0);
+
+    signon_identity_info_free (copy2);
+    signon_identity_info_free (copy);
+    end_test ();
+}
+END_TEST
+
 static void identity_signout_cb (SignonIdentity *self,
                                 const GError *error,
                                 gpointer user_data)
@@ -1543,21 +3539,48 @@ signon_suite(void)
     tcase_set_timeout(tc_core, 1080);
     tcase_add_test (tc_core, test_init);
     tcase_add_test (tc_core, test_query_methods);
+    tcase_add_test (tc_core, test_concurrent_init);
+    tcase_add_test (tc_core, test_thread_contexts);
     tcase_add_test (tc_core, test_query_mechanisms);
     tcase_add_test (tc_core, test_get_existing_identity);
     tcase_add_test (tc_core, test_get_nonexisting_identity);
+    tcase_add_test (tc_core, test_context);
+    tcase_add_test (tc_core, test_context_peer_to_peer);
+    tcase_add_test (tc_core, test_query_cache);
+    tcase_add_test (tc_core, test_query_cache_default_context);
+    tcase_add_test (tc_core, test_default_context_finalized);
+    tcase_add_test (tc_core, test_query_identities);
 
     tcase_add_test (tc_core, test_auth_session_creation);
+    tcase_add_test (tc_core, test_auth_session_concurrent_setup);
+    tcase_add_test (tc_core, test_auth_session_pool);
+    tcase_add_test (tc_core, test_auth_session_pool_no_identity);
+    tcase_add_test (tc_core, test_auth_session_prefetch);
     tcase_add_test (tc_core, test_auth_session_query_mechanisms);
     tcase_add_test (tc_core, test_auth_session_query_mechanisms_nonexisting);
     tcase_add_test (tc_core, test_auth_session_process);
     tcase_add_test (tc_core, test_auth_session_process_async);
+    tcase_add_test (tc_core, test_auth_session_token_cache);
+    tcase_add_test (tc_core, test_auth_session_deduplicate);
+    tcase_add_test (tc_core, test_auth_session_queue);
+    tcase_add_test (tc_core, test_auth_session_priority);
+    tcase_add_test (tc_core, test_auth_session_timeout);
+    tcase_add_test (tc_core, test_auth_session_timeout_shared);
+    tcase_add_test (tc_core, test_auth_session_cancel_waiting);
+    tcase_add_test (tc_core, test_token_refresher);
     tcase_add_test (tc_core, test_auth_session_process_failure);
     tcase_add_test (tc_core, test_auth_session_process_after_store);
     tcase_add_test (tc_core, test_store_credentials_identity);
     tcase_add_test (tc_core, test_verify_secret_identity);
     tcase_add_test (tc_core, test_remove_identity);
     tcase_add_test (tc_core, test_info_identity);
+    tcase_add_test (tc_core, test_info_identity_single_flight);
+    tcase_add_test (tc_core, test_info_identity_shared);
+    tcase_add_test (tc_core, test_info_identity_write_through);
+    tcase_add_test (tc_core, test_identity_interned);
+    tcase_add_test (tc_core, test_identity_new_from_db_many);
+    tcase_add_test (tc_core, test_identity_info_from_variant);
+    tcase_add_test (tc_core, test_identity_info_copy_on_write);
 
     tcase_add_test (tc_core, test_signout_identity);
     tcase_add_test (tc_core, test_unregistered_identity);